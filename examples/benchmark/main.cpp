@@ -0,0 +1,178 @@
+#include "primegen_gmp.h"
+#include <gmpxx.h>
+#include <gmp.h>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Benchmark of library stages across number widths and types
+ *
+ * Usage: benchmark [seconds per measurement] [maximum width]
+ *
+ * Every stage is repeated until the time budget is spent (at least once) and
+ * results are printed as JSON to standard output, so runs of different
+ * releases can be compared by scripts. Stages of type "gmp" are GMP's own
+ * functions on the same inputs (mpz_probab_prime_p with 25 repetitions as
+ * "miller_rabin" and mpz_nextprime as "next_prime").
+ */
+
+namespace {
+typedef std::chrono::steady_clock clock_type;
+
+constexpr unsigned long seed = 254148ul;
+// random odd inputs of each width, used in round robin
+constexpr size_t inputs = 64;
+
+struct result {
+  size_t width;
+  std::string type;
+  std::string stage;
+  size_t iterations;
+  double ns_per_op;
+  // results must be used, GMP declares its tests as pure functions and
+  // compiler could remove them otherwise
+  size_t primes;
+};
+
+std::vector<result> results;
+double budget = 0.2;
+
+// operation is called with iteration number and returns whether it found
+// (or tested) a prime
+template <typename Operation>
+void measure(size_t width, const std::string& type, const std::string& stage,
+             Operation operation) {
+  size_t iterations = 0;
+  size_t primes = 0;
+  clock_type::time_point start = clock_type::now();
+  std::chrono::duration<double> elapsed(0);
+  do {
+    primes += operation(iterations);
+    ++iterations;
+    elapsed = clock_type::now() - start;
+  } while (elapsed.count() < budget);
+  results.push_back({ width, type, stage, iterations,
+                      elapsed.count() * 1e9 / iterations, primes });
+}
+
+template <typename UIntType, size_t w>
+std::vector<UIntType> random_odd_numbers() {
+  std::mt19937 engine(seed + w);
+  std::vector<UIntType> numbers(inputs);
+  for (UIntType& n : numbers) {
+    n = PrimeGen::Utils::independent_bits_generator<UIntType, std::mt19937,
+                                                    w>(engine);
+    n = n | 1;
+    n = n | (UIntType(1) << (w - 1));
+  }
+  return numbers;
+}
+
+template <typename UIntType, size_t w>
+void run_library(const std::string& type) {
+  typedef PrimeGen::Generators::random_prime_engine<
+      UIntType, w, std::mt19937, PrimeGen::Tests::miller_rabin<UIntType, 25> >
+      engine_type;
+  const std::vector<UIntType> numbers = random_odd_numbers<UIntType, w>();
+  engine_type engine(seed + w);
+  const UIntType prime = engine();
+
+  measure(w, type, "trial_division", [&](size_t i) {
+    return PrimeGen::Tests::f1000_prime_factors(numbers[i % inputs]);
+  });
+  measure(w, type, "pow_mod", [&](size_t i) {
+    const UIntType& n = numbers[i % inputs];
+    return PrimeGen::Utils::pow_mod(UIntType(2), UIntType(n - 1), n) == 1;
+  });
+  // all rounds are run only for prime
+  measure(w, type, "miller_rabin", [&](size_t) {
+    return PrimeGen::Tests::miller_rabin<UIntType, 25>(prime);
+  });
+  measure(w, type, "next_prime", [&](size_t i) {
+    return PrimeGen::Generators::next_prime<UIntType, 25>(
+               numbers[i % inputs]) > numbers[i % inputs];
+  });
+  measure(w, type, "random_prime_engine",
+          [&](size_t) { return engine() >= engine.min(); });
+}
+
+template <size_t w> void run_gmp() {
+  const std::vector<mpz_class> numbers = random_odd_numbers<mpz_class, w>();
+  PrimeGen::Generators::pseudo_random_prime_engine<mpz_class, w> engine(seed +
+                                                                       w);
+  const mpz_class prime = engine();
+  mpz_class next;
+
+  measure(w, "gmp", "miller_rabin", [&](size_t) {
+    return mpz_probab_prime_p(prime.get_mpz_t(), 25) != 0;
+  });
+  measure(w, "gmp", "next_prime", [&](size_t i) {
+    mpz_nextprime(next.get_mpz_t(), numbers[i % inputs].get_mpz_t());
+    return next > numbers[i % inputs];
+  });
+}
+
+// built-in type for widths up to 64 bits, PrimeGen::UInt holding double width
+// for bigger numbers
+template <size_t w, bool builtin = (w <= 64)> struct fixed_width {
+  typedef PrimeGen::UInt<2 * w> type;
+  static std::string name() { return "UInt<" + std::to_string(2 * w) + ">"; }
+};
+
+template <size_t w> struct fixed_width<w, true> {
+  typedef uint64_t type;
+  static std::string name() { return "uint64_t"; }
+};
+
+template <size_t w> void run_width(size_t max_width) {
+  if (w > max_width) {
+    return;
+  }
+  run_library<typename fixed_width<w>::type, w>(fixed_width<w>::name());
+  run_library<mpz_class, w>("mpz_class");
+  run_gmp<w>();
+}
+
+void print_json() {
+  std::cout << "{" << std::endl;
+  std::cout << "  \"seed\": " << seed << "," << std::endl;
+  std::cout << "  \"budget_seconds\": " << budget << "," << std::endl;
+  std::cout << "  \"results\": [" << std::endl;
+  for (size_t i = 0; i < results.size(); ++i) {
+    const result& r = results[i];
+    std::cout << "    {\"width\": " << r.width << ", \"type\": \"" << r.type
+              << "\", \"stage\": \"" << r.stage
+              << "\", \"iterations\": " << r.iterations
+              << ", \"ns_per_op\": " << r.ns_per_op
+              << ", \"primes\": " << r.primes << "}"
+              << (i + 1 < results.size() ? "," : "") << std::endl;
+  }
+  std::cout << "  ]" << std::endl;
+  std::cout << "}" << std::endl;
+}
+}
+
+int main(int argc, char** argv) {
+  size_t max_width = 4096;
+  if (argc > 1) {
+    budget = std::atof(argv[1]);
+  }
+  if (argc > 2) {
+    max_width = std::strtoul(argv[2], nullptr, 10);
+  }
+
+  run_width<32>(max_width);
+  run_width<64>(max_width);
+  run_width<128>(max_width);
+  run_width<256>(max_width);
+  run_width<512>(max_width);
+  run_width<1024>(max_width);
+  run_width<2048>(max_width);
+  run_width<4096>(max_width);
+
+  print_json();
+  return 0;
+}
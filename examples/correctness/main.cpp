@@ -0,0 +1,289 @@
+#include "primegen_gmp.h"
+#include "primegen_mmap.h"
+#include <gmpxx.h>
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Checks results of library against straightforward implementations
+ *
+ * Every check prints its name and result, program fails when any check
+ * fails.
+ */
+
+namespace {
+constexpr unsigned long seed = 254148ul;
+size_t failures = 0;
+
+void check(const std::string& name, bool passed) {
+  std::cout << (passed ? "passed: " : "FAILED: ") << name << std::endl;
+  failures += !passed;
+}
+
+// candidates must be all odd numbers from start without factor among first
+// primes_count primes, sieving primes themselves included
+template <uint_fast32_t window, size_t primes_count>
+bool candidates_match(uint_fast64_t start, uint_fast64_t limit) {
+  const auto& primes = KnownPrimes::first_primes<primes_count>;
+  PrimeGen::Utils::candidate_sieve<uint_fast64_t, window, primes_count>
+      candidates(start);
+  for (uint_fast64_t n = start; n < limit; n += 2) {
+    bool composite = false;
+    for (size_t i = 1; i < primes.size() && primes[i] < n; ++i) {
+      if (n % primes[i] == 0) {
+        composite = true;
+        break;
+      }
+    }
+    if (!composite && candidates.next() != n) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void check_candidate_sieve() {
+  // windows smaller than sieving primes, sieving primes must be returned also
+  // from windows after the first one
+  check("candidate_sieve<16> from 7", candidates_match<16, 1000>(7, 10000));
+  check("candidate_sieve<128> from 3", candidates_match<128, 1000>(3, 10000));
+  check("candidate_sieve<4096, 10000> from 3",
+        candidates_match<4096, 10000>(3, 120000));
+  check("candidate_sieve<4096> from 1000001",
+        candidates_match<4096, 1000>(1000001, 1100000));
+}
+
+void check_prime_pi() {
+  // pi(10^k) for k = 1, ..., 14
+  const uint_fast64_t known[] = { 4, 25, 168, 1229, 9592, 78498, 664579,
+                                  5761455, 50847534, 455052511, 4118054813,
+                                  37607912018, 346065536839, 3204941750802 };
+  uint_fast64_t x = 1;
+  bool passed = true;
+  for (uint_fast64_t pi : known) {
+    x *= 10;
+    passed = passed && PrimeGen::Counting::prime_pi(x) == pi;
+  }
+  check("prime_pi(10^k) for k up to 14", passed);
+
+  // random x above the limit where sieve is used directly, sieved in
+  // increasing order so each number is sieved once
+  std::mt19937_64 engine(seed);
+  std::uniform_int_distribution<uint_fast64_t> distribution(100000000,
+                                                            2000000000);
+  std::vector<uint_fast64_t> xs(100);
+  for (uint_fast64_t& value : xs) {
+    value = distribution(engine);
+  }
+  std::sort(xs.begin(), xs.end());
+  uint_fast64_t sieved = 0;
+  uint_fast64_t count = 0;
+  passed = true;
+  for (uint_fast64_t value : xs) {
+    count += PrimeGen::Generators::count_primes_in_range(sieved, value + 1);
+    sieved = value + 1;
+    passed = passed && PrimeGen::Counting::prime_pi(value) == count;
+  }
+  check("prime_pi at random x against count_primes_in_range", passed);
+}
+
+void check_nth_prime() {
+  // p(10^k) for k = 1, ..., 12
+  const uint_fast64_t known[] = { 29, 541, 7919, 104729, 1299709, 15485863,
+                                  179424673, 2038074743, 22801763489,
+                                  252097800623, 2760727302517,
+                                  29996224275833 };
+  uint_fast64_t n = 1;
+  bool passed = true;
+  for (uint_fast64_t p : known) {
+    n *= 10;
+    passed = passed && PrimeGen::Generators::nth_prime(n) == p;
+  }
+  check("nth_prime(10^k) for k up to 12", passed);
+
+  // random n up to pi(2 * 10^9), primes are enumerated in one pass
+  std::mt19937_64 engine(seed);
+  std::uniform_int_distribution<uint_fast64_t> distribution(1, 98222287);
+  std::vector<uint_fast64_t> ns(100);
+  for (uint_fast64_t& value : ns) {
+    value = distribution(engine);
+  }
+  std::sort(ns.begin(), ns.end());
+  std::vector<uint_fast64_t> primes;
+  uint_fast64_t index = 0;
+  PrimeGen::Generators::primes_in_range(0, 2000000000, [&](uint_fast64_t p) {
+    ++index;
+    while (primes.size() < ns.size() && ns[primes.size()] == index) {
+      primes.push_back(p);
+    }
+  });
+  passed = primes.size() == ns.size();
+  for (size_t i = 0; passed && i < ns.size(); ++i) {
+    passed = PrimeGen::Generators::nth_prime(ns[i]) == primes[i];
+  }
+  check("nth_prime at random n against primes_in_range", passed);
+}
+
+template <size_t Bits> mpz_class to_mpz(const PrimeGen::UInt<Bits>& n) {
+  typename PrimeGen::UInt<Bits>::limb_type limbs[PrimeGen::UInt<Bits>::limbs];
+  for (size_t i = 0; i < PrimeGen::UInt<Bits>::limbs; ++i) {
+    limbs[i] = n.limb(i);
+  }
+  mpz_class result;
+  mpz_import(result.get_mpz_t(), PrimeGen::UInt<Bits>::limbs, -1,
+             sizeof(limbs[0]), 0, 0, limbs);
+  return result;
+}
+
+// random number with random bit length, so all sizes of operands are used
+template <size_t Bits>
+PrimeGen::UInt<Bits> random_uint(std::mt19937_64& engine) {
+  PrimeGen::UInt<Bits> n;
+  for (size_t i = 0; i < PrimeGen::UInt<Bits>::limbs; ++i) {
+    n.limb(i) = engine();
+  }
+  return n >> (engine() % Bits);
+}
+
+template <size_t Bits> void check_uint() {
+  typedef PrimeGen::UInt<Bits> uint_type;
+  const mpz_class modulus = mpz_class(1) << Bits;
+  std::mt19937_64 engine(seed);
+  bool arithmetic = true;
+  bool comparison = true;
+  bool pow_mod = true;
+  for (size_t i = 0; i < 10000; ++i) {
+    const uint_type a = random_uint<Bits>(engine);
+    uint_type b = random_uint<Bits>(engine);
+    if (b == 0) {
+      b = 1;
+    }
+    const mpz_class x = to_mpz(a);
+    const mpz_class y = to_mpz(b);
+    const size_t shift = engine() % Bits;
+    arithmetic = arithmetic && to_mpz(a + b) == (x + y) % modulus &&
+                 to_mpz(a - b) == (x - y + modulus) % modulus &&
+                 to_mpz(a * b) == (x * y) % modulus && to_mpz(a / b) == x / y &&
+                 to_mpz(a % b) == x % y && to_mpz(a & b) == (x & y) &&
+                 to_mpz(a | b) == (x | y) && to_mpz(a ^ b) == (x ^ y) &&
+                 to_mpz(a << shift) == (x << shift) % modulus &&
+                 to_mpz(a >> shift) == x >> shift;
+    comparison = comparison && (a < b) == (x < y) && (a == b) == (x == y) &&
+                 (a == a);
+    // moduli must fit in half of the width, both odd (Montgomery form) and
+    // even ones are used
+    uint_type m = b >> (Bits / 2);
+    if (m < 2) {
+      m = 2;
+    }
+    const uint_type base = a % m;
+    mpz_class expected;
+    mpz_powm(expected.get_mpz_t(), to_mpz(base).get_mpz_t(), x.get_mpz_t(),
+             to_mpz(m).get_mpz_t());
+    pow_mod = pow_mod && to_mpz(PrimeGen::Utils::pow_mod(base, a, m)) ==
+                             expected;
+  }
+  const std::string name = "UInt<" + std::to_string(Bits) + "> ";
+  check(name + "arithmetic against mpz_class", arithmetic);
+  check(name + "comparison against mpz_class", comparison);
+  check(name + "pow_mod against mpz_powm", pow_mod);
+}
+
+// factors must be primes in increasing order with product n
+template <typename UIntType, typename PrimalityTest>
+bool factorization_valid(const UIntType& n, PrimalityTest is_prime) {
+  const std::vector<UIntType> factors = PrimeGen::Factor::factorize(n);
+  UIntType product = 1;
+  for (size_t i = 0; i < factors.size(); ++i) {
+    if (!is_prime(factors[i]) || (i > 0 && factors[i] < factors[i - 1])) {
+      return false;
+    }
+    product = product * factors[i];
+  }
+  return product == n;
+}
+
+void check_factorize() {
+  std::mt19937_64 engine(seed);
+  auto is_prime_64 = [](const uint64_t& n) {
+    return n < 4 ? n > 1
+                 : PrimeGen::Tests::miller_rabin_deterministic_64<uint64_t>(n);
+  };
+  bool passed = true;
+  for (size_t i = 0; i < 2000; ++i) {
+    // random bit lengths, so small, smooth and semiprime-like numbers occur
+    uint64_t n = (engine() >> (engine() % 64)) | 1;
+    passed = passed && factorization_valid(n, is_prime_64);
+  }
+  for (uint64_t n = 1; n < 10000; ++n) {
+    passed = passed && factorization_valid(n, is_prime_64);
+  }
+  check("factorize<uint64_t>", passed);
+
+  // products of two primes of about 48 bits, the hardest case for rho
+  passed = true;
+  for (size_t i = 0; i < 5; ++i) {
+    mpz_class p = PrimeGen::Generators::next_prime<mpz_class, 25>(
+        mpz_class(std::to_string(engine() >> 16)));
+    mpz_class q = PrimeGen::Generators::next_prime<mpz_class, 25>(
+        mpz_class(std::to_string(engine() >> 16)));
+    mpz_class n = p * q * (engine() % 1000 + 1);
+    passed = passed && factorization_valid(n, [](const mpz_class& f) {
+               return mpz_probab_prime_p(f.get_mpz_t(), 25) != 0;
+             });
+  }
+  check("factorize<mpz_class> of semiprimes", passed);
+}
+
+void check_prime_bitmap() {
+  // limit not divisible by 30, so the last byte is partial
+  constexpr uint_fast64_t limit = 10000019;
+  const char* path = "correctness_bitmap.bin";
+  std::vector<bool> is_prime(limit, true);
+  is_prime[0] = is_prime[1] = false;
+  for (uint_fast64_t p = 2; p * p < limit; ++p) {
+    if (is_prime[p]) {
+      for (uint_fast64_t m = p * p; m < limit; m += p) {
+        is_prime[m] = false;
+      }
+    }
+  }
+  bool passed = PrimeGen::Storage::write_prime_bitmap(path, limit);
+  PrimeGen::Storage::prime_bitmap bitmap(path);
+  passed = passed && bitmap.is_open() && bitmap.limit() == limit;
+  uint_fast64_t previous = 0;
+  for (uint_fast64_t n = 0; passed && n < limit; ++n) {
+    passed = bitmap.is_prime(n) == is_prime[n] &&
+             bitmap.prev_prime(n) == previous;
+    if (is_prime[n]) {
+      passed = passed && bitmap.next_prime(previous) == n;
+      previous = n;
+    }
+  }
+  passed = passed && bitmap.next_prime(previous) == 0 &&
+           bitmap.prev_prime(limit) == previous &&
+           bitmap.next_prime(~uint_fast64_t(0)) == 0 &&
+           bitmap.prev_prime(~uint_fast64_t(0)) == previous;
+  std::remove(path);
+  check("prime_bitmap against sieve of Eratosthenes", passed);
+}
+}
+
+int main() {
+  check_candidate_sieve();
+  check_prime_pi();
+  check_nth_prime();
+  check_uint<64>();
+  check_uint<128>();
+  check_uint<256>();
+  check_uint<1024>();
+  check_factorize();
+  check_prime_bitmap();
+
+  std::cout << failures << " checks failed" << std::endl;
+  return failures == 0 ? 0 : 1;
+}
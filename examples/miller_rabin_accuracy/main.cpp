@@ -1,4 +1,4 @@
-#include "primegen.h"
+#include "primegen_gmp.h"
 #include <gmpxx.h>
 #include <utility>
 #include <algorithm>
@@ -1,4 +1,4 @@
-#include "primegen.h"
+#include "primegen_gmp.h"
 #include <gmpxx.h>
 #include <gmp.h>
 #include <utility>
@@ -34,6 +34,10 @@ int main() {
 
     duration_t gmp_duration(0);
     duration_t primegen_duration(0);
+    // results must be used, GMP declares its tests as pure functions and
+    // compiler could remove them otherwise
+    size_t gmp_primes = 0;
+    size_t primegen_primes = 0;
     mpz_class j;
 
     for (size_t i = 0; i < iterations; ++i) {
@@ -41,12 +45,12 @@ int main() {
           mpz_class, std::minstd_rand, 2048>(rnd);
 
       start = clock.now();
-      mpz_millerrabin(j.get_mpz_t(), 25);
+      gmp_primes += mpz_millerrabin(j.get_mpz_t(), 25) != 0;
       end = clock.now();
       gmp_duration += std::chrono::duration_cast<duration_t>(end - start);
 
       start = clock.now();
-      PrimeGen::Tests::miller_rabin<mpz_class, 25>(j);
+      primegen_primes += PrimeGen::Tests::miller_rabin<mpz_class, 25>(j);
       end = clock.now();
       primegen_duration += std::chrono::duration_cast<duration_t>(end - start);
     }
@@ -58,6 +62,8 @@ int main() {
               << std::chrono::duration_cast<std::chrono::milliseconds>(
                      gmp_duration).count() /
                      1000.0 << " seconds" << std::endl;
+    std::cout << "Primes found: " << primegen_primes << " (Primegen), "
+              << gmp_primes << " (GMP)" << std::endl;
     std::cout << std::endl << std::endl;
   }
 
@@ -68,6 +74,10 @@ int main() {
 
     duration_t gmp_duration(0);
     duration_t primegen_duration(0);
+    // results must be used, GMP declares its tests as pure functions and
+    // compiler could remove them otherwise
+    size_t gmp_primes = 0;
+    size_t primegen_primes = 0;
     mpz_class j;
 
     for (size_t i = 0; i < iterations; ++i) {
@@ -75,13 +85,13 @@ int main() {
           mpz_class, std::minstd_rand, 2048>(rnd);
 
       start = clock.now();
-      mpz_probab_prime_p(j.get_mpz_t(), 25);
+      gmp_primes += mpz_probab_prime_p(j.get_mpz_t(), 25) != 0;
       end = clock.now();
       gmp_duration += std::chrono::duration_cast<duration_t>(end - start);
 
       start = clock.now();
-      PrimeGen::Tests::f1000_prime_factors(j) &&
-          PrimeGen::Tests::miller_rabin<mpz_class, 25>(j);
+      primegen_primes += PrimeGen::Tests::f1000_prime_factors(j) &&
+                         PrimeGen::Tests::miller_rabin<mpz_class, 25>(j);
       end = clock.now();
       primegen_duration += std::chrono::duration_cast<duration_t>(end - start);
     }
@@ -93,6 +103,8 @@ int main() {
               << std::chrono::duration_cast<std::chrono::milliseconds>(
                      gmp_duration).count() /
                      1000.0 << " seconds" << std::endl;
+    std::cout << "Primes found: " << primegen_primes << " (Primegen), "
+              << gmp_primes << " (GMP)" << std::endl;
     std::cout << std::endl << std::endl;
   }
 
@@ -3,8 +3,38 @@
 
 #include <utility>
 #include <random>
-#include <sstream>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <iterator>
+#include <array>
+#include <tuple>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 #include "known_primes.h"
+#include "uint.h"
+
+// 128b arithmetic is used for Montgomery multiplication of 64b numbers
+#ifdef __SIZEOF_INT128__
+#define PRIMEGEN_HAS_UINT128 1
+#else
+#define PRIMEGEN_HAS_UINT128 0
+#endif
+
+// AVX2 code is compiled with target attribute and selected at runtime
+#if (defined(__GNUC__) || defined(__clang__)) &&                              \
+    (defined(__x86_64__) || defined(__i386__))
+#define PRIMEGEN_HAS_AVX2_DISPATCH 1
+#include <immintrin.h>
+#else
+#define PRIMEGEN_HAS_AVX2_DISPATCH 0
+#endif
 
 /* DEFINITIONS */
 
@@ -23,13 +53,34 @@
 *
 * Instead of standard unsigned integer types, any user-defined class may be
 * used for \c UIntType. Class must define at least <tt>= + & ++ (prefix) == < !=
-* > % >> << - * </tt> operators and must provide << stream operator (used for
-* conversions), with the same behavior they have with standard unsigned integer
-* types and must be interoperable with standard unsigned integer types. All
-* library functions have been tested with GNU MP Bignum Library's \c mpz_class.
+* > % >> << - * </tt> operators with the same behavior they have with standard
+* unsigned integer types and must be interoperable with standard unsigned
+* integer types. Conversions and modular arithmetic in hot paths go through
+* Utils::number_traits, which may be specialized for faster access to number
+* representation. All library functions have been tested with GNU MP Bignum
+* Library's \c mpz_class.
+* Include primegen_gmp.h instead of primegen.h when using \c mpz_class, hot
+* paths are then specialized to use GMP's kernels (e.g. \c mpz_powm).
+*
+* Library provides its own fixed-width PrimeGen::UInt, which keeps limbs on
+* stack and doesn't allocate memory. It can be used instead of \c mpz_class if
+* GMP is not available or allocations are not desirable.
+*
+* @section native Working with built-in types
+*
+* Built-in 32b and 64b unsigned integer types (only 32b if compiler does not
+* provide \c unsigned \c __int128) are detected by Utils::is_native_uint.
+* Modular arithmetic for them is done in Montgomery form (see
+* Utils::montgomery) without any division in the inner loops and without
+* overflows, so \c UIntType needs to hold only tested number itself (e.g. \c
+* uint64_t is enough for testing any 64b number).
 */
 
 namespace PrimeGen {
+namespace Utils {
+struct no_stats;
+}
+
 /**
 * @brief Prime generators
 */
@@ -50,14 +101,22 @@ namespace Generators {
 * random numbers. Entropy provided by this engine directly affects entropy of
 * generated primes (ie. quality of this engine is really important)
 *
-* @tparam PrimarityTest Test used for primarity testing. First fast
-* test for 1000 first primes is applied on generated number, then \c
-* PrimarityTest is runned. No further testing is done, use with caution.
+* @tparam PrimarityTest Test used for primarity testing. Candidates are first
+* sieved by \c sieve_primes first primes (see Utils::candidate_sieve), then
+* \c PrimarityTest is runned. No further testing is done, use with caution.
+*
+* @tparam sieve_primes Number of primes used for sieving candidates. Deeper
+* sieving saves primality tests of big numbers (thousands of bits).
+*
+* @tparam Stats Statistics policy, Utils::thread_stats records counts and
+* cycles of pipeline stages, default Utils::no_stats compiles to nothing.
 *
 * @see Tests::miller_rabin
+* @see Tests::baillie_psw
 */
 template <typename UIntType, size_t w, typename RandomNumberEngine,
-          bool (&PrimarityTest)(const UIntType&)>
+          bool (&PrimarityTest)(const UIntType&), size_t sieve_primes = 1000,
+          typename Stats = Utils::no_stats>
 class random_prime_engine {
 public:
   typedef UIntType result_type;
@@ -90,7 +149,7 @@ public:
   * @return The minimum potentially generated value
   * which is always \f$ 2^{w-1} \f$
   */
-  static constexpr result_type min() { return 1u << (w - 1); }
+  static constexpr result_type min() { return result_type(1) << (w - 1); }
   /**
   * @brief Returns the maximum value potentially
   * generated by the random-number engine.
@@ -106,6 +165,173 @@ private:
   RandomNumberEngine e_;
 };
 
+/**
+* @brief Random safe prime generator
+*
+* @details Generates safe prime \f$ p = 2q + 1 \f$, where \f$ q = (p - 1) / 2
+* \f$ is Sophie Germain prime. Candidates for \c q are sieved together with
+* \f$ 2q + 1 \f$ (see Utils::safe_candidate_sieve), so candidate is rejected
+* when any of them has small prime factor. Survivors are tested by cheap
+* strong probable-prime test of \c q to base 2 first, then \c p is tested by
+* Fermat test to base 2, which (by Pocklington's theorem) proves \c p prime
+* whenever \c q is prime. Only then expensive \c PrimarityTest is run on \c
+* q. Candidates for \c q never exceed \f$ w - 1 \f$ bits, the search is
+* started again from new random number in such case.
+*
+* @tparam UIntType Unsigned integer type. Must be able to hold 2 times maximum
+* of \c w.
+*
+* @tparam w Size of generated safe prime in bits. Generated number
+* will be always greater than \f$ 2^{w-1} \f$. \f$ 2^{w-2} \f$ must be
+* greater than the largest sieving prime (e.g. \c w must be at least 15 for
+* default \c sieve_primes).
+*
+* @tparam RandomNumberEngine Engine used as base for generating
+* random numbers (see random_prime_engine).
+*
+* @tparam PrimarityTest Test used for primarity testing of \c q.
+*
+* @tparam sieve_primes Number of primes used for sieving candidates.
+*
+* @see random_prime_engine
+*/
+template <typename UIntType, size_t w, typename RandomNumberEngine,
+          bool (&PrimarityTest)(const UIntType&), size_t sieve_primes = 1000>
+class safe_prime_engine {
+  static_assert(w > 2 && (uint_fast64_t(1) << std::min<size_t>(w - 2, 63)) >
+                             KnownPrimes::first_primes<sieve_primes>.back(),
+                "2^{w-2} must be greater than the largest sieving prime");
+
+public:
+  typedef UIntType result_type;
+
+  /**
+  * @brief Constructs \c safe_prime_engine with
+  * underlying \c RandomNumberEngine
+  *
+  * @param args Arguments passed to underlying \c
+  * RandomNumberEngine constructor
+  */
+  template <typename... Args>
+  safe_prime_engine(Args&&... args)
+      : e_(std::forward<Args>(args)...) {}
+
+  /**
+  * @brief Generates safe prime
+  *
+  * @details The state of the engine is advanced by one position.
+  *
+  * @return A random safe prime in [min(), max()], \f$ (p - 1) / 2 \f$ is
+  * Sophie Germain prime.
+  */
+  result_type operator()();
+  const RandomNumberEngine& base() const { return e_; }
+  /// @return \f$ 2^{w-1} \f$
+  static constexpr result_type min() { return result_type(1) << (w - 1); }
+  /// @return maximum of \c UIntType
+  static constexpr result_type max() {
+    return std::numeric_limits<UIntType>::max();
+  }
+
+private:
+  RandomNumberEngine e_;
+};
+
+/**
+* @brief Random prime generator for RSA moduli
+*
+* @details Generates primes with two highest bits set (so product of two such
+* primes has exactly \f$ 2w \f$ bits) and with \f$ \gcd(p - 1, e) = 1 \f$ for
+* public exponent \f$ e \f$. Both constraints are applied before any
+* primality test: the bits are set in random starting point and candidates
+* \f$ p \equiv 1 \pmod{r} \f$ for prime factors \f$ r \f$ of \f$ e \f$ are
+* crossed off in candidate sieve (see Utils::candidate_sieve::exclude).
+* Candidates never exceed \c w bits, the search is started again from new
+* random number in such case.
+*
+* @tparam UIntType Unsigned integer type. Must be able to hold 2 times maximum
+* of \c w.
+*
+* @tparam w Size of generated prime in bits, must be greater than 2.
+*
+* @tparam RandomNumberEngine Engine used as base for generating
+* random numbers (see random_prime_engine).
+*
+* @tparam PrimarityTest Test used for primarity testing.
+*
+* @tparam public_exponent RSA public exponent \f$ e \f$, must be odd
+*
+* @tparam sieve_primes Number of primes used for sieving candidates.
+*
+* @see random_prime_engine
+*/
+template <typename UIntType, size_t w, typename RandomNumberEngine,
+          bool (&PrimarityTest)(const UIntType&),
+          uint_fast32_t public_exponent = 65537, size_t sieve_primes = 1000>
+class rsa_prime_engine {
+  static_assert(w > 2, "w must be greater than 2");
+  static_assert(public_exponent % 2 == 1, "public exponent must be odd");
+
+public:
+  typedef UIntType result_type;
+
+  /**
+  * @brief Constructs \c rsa_prime_engine with
+  * underlying \c RandomNumberEngine
+  *
+  * @param args Arguments passed to underlying \c
+  * RandomNumberEngine constructor
+  */
+  template <typename... Args> rsa_prime_engine(Args&&... args);
+
+  /**
+  * @brief Generates prime
+  *
+  * @details The state of the engine is advanced by one position.
+  *
+  * @return A random prime \f$ p \f$ in [min(), max()] with \f$ \gcd(p - 1,
+  * e) = 1 \f$.
+  */
+  result_type operator()();
+  const RandomNumberEngine& base() const { return e_; }
+  /// @return \f$ 2^{w-1} + 2^{w-2} \f$
+  static constexpr result_type min() { return result_type(3) << (w - 2); }
+  /// @return \f$ 2^w - 1 \f$
+  static constexpr result_type max() {
+    // shifted in two steps, w may be equal to width of UIntType
+    return ((result_type(1) << (w - 1)) << 1) - 1;
+  }
+
+private:
+  RandomNumberEngine e_;
+  std::vector<uint_fast32_t> exponent_factors_; // prime factors of e
+};
+
+/**
+* @brief Generates batch of random primes using multiple threads
+*
+* @details Each prime is generated by its own copy of \c PrimeEngine, seeded
+* with \c std::seed_seq made from \c seed and index of the prime. Workers
+* take indices from shared atomic counter and store primes to their slots, so
+* there are no locks and result is reproducible for given \c seed regardless
+* of number of threads. Engines which can't be seeded by \c std::seed_seq
+* (e.g. \c std::random_device) are default-constructed instead. Requires
+* linking with thread library (\c -pthread).
+*
+* @tparam PrimeEngine random_prime_engine specialization, e.g.
+* pseudo_random_prime_engine
+*
+* @param count number of primes to generate
+* @param seed seed of the batch
+* @param threads number of threads, 0 means \c
+* std::thread::hardware_concurrency()
+*
+* @return \c count primes, i-th prime depends only on \c seed and i
+*/
+template <typename PrimeEngine>
+std::vector<typename PrimeEngine::result_type>
+random_primes(size_t count, uint_fast64_t seed, unsigned threads = 0);
+
 /**
 * @brief Generates next prime greater than \c n
 *
@@ -129,6 +355,267 @@ private:
 */
 template <typename UIntType, uint_fast32_t accuracy>
 UIntType next_prime(UIntType n);
+
+/**
+* @brief Generates next prime greater than \c n using given primality test
+*
+* @tparam UIntType Unsigned integer type. Must be able to hold 2
+* times size of \c result (see next_prime above).
+*
+* @tparam PrimarityTest Test used for primarity testing. Candidates are first
+* sieved by \c sieve_primes first primes (see Utils::candidate_sieve), then
+* \c PrimarityTest is runned.
+*
+* @tparam sieve_primes Number of primes used for sieving candidates.
+*
+* @tparam Stats Statistics policy (see random_prime_engine).
+*
+* @see Tests::miller_rabin
+* @see Tests::baillie_psw
+*
+* @param n Generated prime will be greater than \c n. \c n must be
+* greater than 3.
+*
+* @return Prime greater than \c n. There should be no other primes
+* between \c n and generated prime (as far as \c PrimarityTest is reliable).
+*/
+template <typename UIntType, bool (&PrimarityTest)(const UIntType&),
+          size_t sieve_primes = 1000, typename Stats = Utils::no_stats>
+UIntType next_prime(UIntType n);
+
+/**
+* @brief Generates next prime greater than \c n using multiple threads
+*
+* @details Candidates above \c n are split to windows of 128 odd numbers.
+* Threads claim windows in increasing order from shared atomic counter, sieve
+* them (residues of \c n are computed once and shared) and test survivors
+* concurrently. When a prime is found, windows above it are abandoned, but all
+* lower windows are finished, so the smallest prime greater than \c n is
+* returned. Worth for big numbers (thousands of bits) only. Requires linking
+* with thread library (\c -pthread).
+*
+* @tparam UIntType Unsigned integer type (see next_prime above). Operations on
+* different objects must be thread-safe.
+*
+* @tparam PrimarityTest Test used for primarity testing, must be thread-safe.
+*
+* @param n Generated prime will be greater than \c n. \c n must be
+* greater than 3.
+* @param threads number of threads, 0 means \c
+* std::thread::hardware_concurrency()
+*
+* @return Prime greater than \c n. There should be no other primes
+* between \c n and generated prime (as far as \c PrimarityTest is reliable).
+*/
+template <typename UIntType, bool (&PrimarityTest)(const UIntType&)>
+UIntType parallel_next_prime(UIntType n, unsigned threads = 0);
+
+/**
+* @brief Generates next prime greater than \c n using multiple threads
+*
+* @details Same as above, using Tests::miller_rabin with given \c accuracy.
+*
+* @param n Generated prime will be greater than \c n. \c n must be
+* greater than 3.
+* @param threads number of threads, 0 means \c
+* std::thread::hardware_concurrency()
+*/
+template <typename UIntType, uint_fast32_t accuracy>
+UIntType parallel_next_prime(UIntType n, unsigned threads = 0);
+
+/**
+* @brief Generates all primes in range [lo, hi)
+*
+* @details Segmented sieve of Eratosthenes with mod 30 wheel is used, each
+* segment (32 KiB, ie. 983040 numbers) fits in L1 cache. Only primes up to
+* \f$ \sqrt{hi} \f$ are held in memory.
+*
+* @tparam Function function object callable as \c f(uint_fast64_t)
+*
+* @param lo lower bound (inclusive)
+* @param hi upper bound (exclusive), must be lower than \f$ 2^{63} \f$
+* @param f called for each prime in increasing order
+*/
+template <typename Function>
+void primes_in_range(uint_fast64_t lo, uint_fast64_t hi, Function f);
+
+/**
+* @brief Generates primes in range [lo, hi) to buffer
+*
+* @details Same as above, sieving stops when buffer is full. Remaining primes
+* can be generated by calling function again with \c lo set to last prime + 1.
+* Sieved range is estimated from the capacity of buffer, so cost doesn't
+* depend on \c hi.
+*
+* @param lo lower bound (inclusive)
+* @param hi upper bound (exclusive), must be lower than \f$ 2^{63} \f$
+* @param buffer buffer for primes
+* @param size capacity of \c buffer
+*
+* @return number of primes written to \c buffer
+*/
+inline size_t primes_in_range(uint_fast64_t lo, uint_fast64_t hi,
+                              uint_fast64_t* buffer, size_t size);
+
+/**
+* @brief Generates all primes in range [lo, hi) using multiple threads
+*
+* @details Range is split to blocks of 16 segments. Worker threads take
+* blocks from shared atomic counter, each owns its segment buffer and offsets
+* of sieving primes, the only shared data are the sieving primes themselves
+* (read-only). Primes of each block are stored to one of \f$ 2 \cdot threads
+* \f$ reorder buffers and \c f is called from calling thread in increasing
+* order while workers sieve following blocks, so \c f doesn't need to be
+* thread-safe. Requires linking with thread library (\c -pthread).
+*
+* Every segment visits all sieving primes up to \f$ \sqrt{hi} \f$ (there is
+* no bucket sieve for primes greater than segment), so throughput drops when
+* most sieving primes have no multiple in a segment: \f$ 10^8 \f$ numbers
+* take about 0.2 s of one core at \f$ 10^{12} \f$, 2 s at \f$ 10^{15} \f$
+* and 50 s at \f$ 10^{18} \f$.
+*
+* @tparam Function function object callable as \c f(uint_fast64_t)
+*
+* @param lo lower bound (inclusive)
+* @param hi upper bound (exclusive), must be lower than \f$ 2^{63} \f$
+* @param f called for each prime in increasing order
+* @param threads number of threads, 0 means \c
+* std::thread::hardware_concurrency()
+*/
+template <typename Function>
+void parallel_primes_in_range(uint_fast64_t lo, uint_fast64_t hi, Function f,
+                              unsigned threads = 0);
+
+/**
+* @brief Counts primes in range [lo, hi) using multiple threads
+*
+* @details Threads take blocks of 16 segments from shared atomic counter and
+* count primes without any locking. Requires linking with thread library (\c
+* -pthread).
+*
+* @param lo lower bound (inclusive)
+* @param hi upper bound (exclusive), must be lower than \f$ 2^{63} \f$
+* @param threads number of threads, 0 means \c
+* std::thread::hardware_concurrency()
+*
+* @return number of primes in [lo, hi)
+*/
+inline uint_fast64_t count_primes_in_range(uint_fast64_t lo, uint_fast64_t hi,
+                                           unsigned threads = 0);
+
+/**
+* @brief Generates n-th prime
+*
+* @details Location of n-th prime is estimated by inverse of Riemann's
+* function \f$ R(x) \f$, primes up to the estimate are counted by
+* Counting::prime_pi and the remaining distance (usually few thousands of
+* primes) is walked by sieving windows of about \f$ \sqrt{x} \f$ numbers
+* around the estimate. Cost is dominated by the single Counting::prime_pi
+* call, ie. \f$ O(p_n^{2/3}) \f$. Requires linking with thread library (\c
+* -pthread).
+*
+* @param n index of prime, must be greater than 0 (1st prime is 2)
+* @param threads number of threads, 0 means \c
+* std::thread::hardware_concurrency()
+*
+* @return n-th prime, must be lower than \f$ 2^{63} \f$
+*/
+inline uint_fast64_t nth_prime(uint_fast64_t n, unsigned threads = 0);
+}
+
+/**
+* @brief Prime counting
+*/
+namespace Counting {
+/**
+* @brief Prime counting function \f$ \pi(x) \f$
+*
+* @details Combinatorial method of Lagarias, Miller and Odlyzko is used,
+* without sieving the whole range. Partial sieve function \f$ \phi(x, a) \f$
+* is split to leaves \f$ \phi(x / n, b) \f$ for \f$ n \le y = \alpha
+* \sqrt[3]{x} \f$, special leaves are counted by segmented sieve of numbers up
+* to \f$ x / y \f$. Leaves with value below \f$ y \f$ are counted by lookup
+* table in clusters (as in Deleglise-Rivat variant). Time complexity is about
+* \f$ O(x^{2/3}) \f$ and memory \f$ O(x^{1/3}) \f$, e.g. \f$ \pi(10^{16}) \f$
+* needs only few megabytes. Segments of the sieve are processed concurrently.
+* Small \c x are counted by Generators::count_primes_in_range. Requires
+* linking with thread library (\c -pthread).
+*
+* @param x upper bound (inclusive), must be lower than \f$ 2^{63} \f$
+* @param threads number of threads, 0 means \c
+* std::thread::hardware_concurrency()
+*
+* @return number of primes not greater than \c x
+*/
+inline uint_fast64_t prime_pi(uint_fast64_t x, unsigned threads = 0);
+}
+
+/**
+* @brief Integer factorization
+*
+* @details Arithmetic modulo factorized number is done in Montgomery form for
+* built-in types (see Utils::montgomery, 128b numbers have their own
+* Montgomery multiplication when \c unsigned \c __int128 is available) and by
+* Utils::mul_mod for other types.
+*/
+namespace Factor {
+/**
+* @brief Prime factorization
+*
+* @details Factors up to 7919 are found by trial division by
+* KnownPrimes::first_1000_primes. Remaining cofactor is split by
+* pollard_p_minus_1 (only for numbers wider than 64b, where smooth factors are
+* worth looking for) and pollard_rho, recursion stops on factors proven prime
+* by Tests::miller_rabin_deterministic_64 (numbers lower than \f$ 2^{64} \f$)
+* or probable primes by Miller-Rabin test with accuracy 25 (bigger numbers).
+*
+* @tparam UIntType Unsigned integer type. Must be able to hold 2 times size of
+* \c n, built-in types and \c unsigned \c __int128 need to hold only \c n
+* (see @ref native). Besides operators required by the rest of library, \c
+* / and \c /= are used to divide out found factors.
+*
+* @param n number to factorize, must be greater than 0
+*
+* @return prime factors of \c n with multiplicity in increasing order (empty
+* for 1)
+*/
+template <typename UIntType> std::vector<UIntType> factorize(UIntType n);
+
+/**
+* @brief Pollard's rho method with Brent's cycle detection
+*
+* @details Pseudorandom sequence \f$ x_{i+1} = x_i^2 + c \f$ is iterated and
+* differences of its values are multiplied together, so GCD with \c n is
+* computed only once per 128 steps. Expected number of steps is about \f$
+* \sqrt{p} \f$ for the smallest prime factor \f$ p \f$. When a batch
+* overshoots (GCD is \c n), its steps are repeated one by one, when even that
+* fails, next \c c is tried.
+*
+* @tparam UIntType Unsigned integer type (see factorize).
+*
+* @param n composite number greater than 3, must not be a prime (method would
+* never finish)
+*
+* @return nontrivial factor of \c n (not necessarily prime)
+*/
+template <typename UIntType> UIntType pollard_rho(const UIntType& n);
+
+/**
+* @brief Pollard's p - 1 method (stage 1)
+*
+* @details Computes \f$ \gcd(2^E - 1, n) \f$, where \f$ E \f$ is product of
+* all prime powers up to \c bound, so factor \f$ p \f$ is found when \f$ p
+* - 1 \f$ has only prime power factors up to \c bound.
+*
+* @tparam UIntType Unsigned integer type (see factorize).
+*
+* @param n odd number greater than 3
+* @param bound smoothness bound
+*
+* @return factor of \c n, 1 or \c n when no nontrivial factor was found
+*/
+template <typename UIntType>
+UIntType pollard_p_minus_1(const UIntType& n, uint_fast32_t bound = 65536);
 }
 
 /**
@@ -140,7 +627,8 @@ namespace Tests {
 *
 * @tparam UIntType Unsigned integer type. Must be able to hold 2
 * times size of \c n. (Even if \c n would fit in 32b type \c UIntType must be
-* able to hold 64b number.)
+* able to hold 64b number.) Built-in types need to hold only \c n, see @ref
+* native.
 *
 * @param n Number to be tested for primality. Must be greater than
 * 3.
@@ -157,12 +645,30 @@ namespace Tests {
 template <typename UIntType, size_t accuracy>
 bool miller_rabin(const UIntType& n);
 
+/**
+* @brief Miller-Rabin probabilistic primality test with caller-supplied source
+* of witnesses.
+*
+* @details Same as above, but witnesses are drawn uniformly from \f$ [2, n-2]
+* \f$ using \c engine. The overload without engine uses thread-local \c
+* std::mt19937 seeded once per thread from \c std::random_device.
+*
+* @tparam RandomNumberEngine Uniform random bit generator (e.g. any engine
+* from \c \<random\>). Internal state of engine will be modified.
+*
+* @param n Number to be tested for primality. Must be greater than 3.
+* @param engine Initialized number generator
+*/
+template <typename UIntType, size_t accuracy, typename RandomNumberEngine>
+bool miller_rabin(const UIntType& n, RandomNumberEngine& engine);
+
 /**
 * @brief Miller-Rabin deterministic primality test.
 *
 * @details This test depends on (unproved in time of writting)
 * generalized Riemann hypothesis. Don't use this test if dependency on
-* unproved theories is unaccetable for you.
+* unproved theories is unaccetable for you. If \c w is at most 64, \c
+* miller_rabin_deterministic_64 is used instead, which does not depend on GRH.
 *
 * @tparam UIntType Unsigned integer type. Must be able to hold 2
 * times size of \c n. (Even if \c n would fit in 32b type \c UIntType must be
@@ -179,11 +685,57 @@ bool miller_rabin(const UIntType& n);
 template <typename UIntType, size_t w = std::numeric_limits<UIntType>::digits>
 bool miller_rabin_deterministic(const UIntType& n);
 
+/**
+* @brief Deterministic Miller-Rabin test for numbers lower than \f$ 2^{64} \f$
+*
+* @details Uses known minimal witness sets, so no unproved theory is needed.
+* Numbers lower than 4759123141 are tested with 3 witnesses (2, 7, 61), rest
+* with 7 witnesses (2, 325, 9375, 28178, 450775, 9780504, 1795265022) found by
+* Jim Sinclair.
+*
+* @tparam UIntType Unsigned integer type. Must be able to hold 2
+* times size of \c n, built-in types need to hold only \c n (see @ref native).
+*
+* @param n Number to be tested for primality. Must be greater than
+* 3 and lower than \f$ 2^{64} \f$.
+*
+* @return \c true if number is prime, \c false if number
+* is composite.
+*/
+template <typename UIntType>
+bool miller_rabin_deterministic_64(const UIntType& n);
+
+/**
+* @brief Deterministic Miller-Rabin test of many 32b or 64b numbers
+*
+* @details Gives same results as miller_rabin_deterministic_64 for each
+* number, but Montgomery exponentiations of several numbers run in lockstep.
+* Every number is tested to base 2 first, only survivors are tested to
+* remaining bases. 32b numbers are tested 8 at once in AVX2 registers when CPU
+* supports it (detected at runtime), 64b numbers are tested 8 at once in
+* interleaved independent multiplication chains.
+*
+* @tparam UIntType 32b or 64b built-in unsigned integer type,
+* Utils::is_native_uint must hold for it.
+*
+* @param numbers numbers to be tested for primality, any value is allowed
+* @param count number of numbers
+* @param results \c results[i] is set to \c true if \c numbers[i] is prime
+*/
+template <typename UIntType>
+void miller_rabin_batch(const UIntType* numbers, size_t count, bool* results);
+
 /**
 * @brief Quick test, testing only first 100 prime factors.
 *
 * @tparam UIntType Unsigned integer type.
 *
+* @details For 32b and 64b built-in types division is replaced by
+* multiplication with precomputed inverses of primes (\f$ p \mid n \f$ iff
+* \f$ n p^{-1} \bmod 2^w \le \lfloor (2^w - 1) / p \rfloor \f$), evaluated
+* in blocks of 16 primes in AVX2 registers when CPU supports it (detected at
+* runtime).
+*
 * @param n number to be tested for primality
 *
 * @return \c true if no prime factor was found, \c false otherwise.
@@ -192,11 +744,50 @@ bool miller_rabin_deterministic(const UIntType& n);
 */
 template <typename UIntType> bool f100_prime_factors(const UIntType& n);
 
+/**
+* @brief Strong Lucas probable-prime test
+*
+* @details Lucas sequences with parameters chosen by Selfridge's method A (\f$
+* P = 1 \f$, \f$ Q = (1 - D) / 4 \f$ for first \f$ D \f$ in 5, -7, 9, -11,
+* ... with Jacobi symbol \f$ (D / n) = -1 \f$) are used.
+*
+* @tparam UIntType Unsigned integer type. Must be able to hold 2
+* times size of \c n, built-in types need to hold only \c n (see @ref native).
+*
+* @param n Number to be tested for primality. Must be greater than 3.
+*
+* @return \c true if number is probable prime, \c false if number
+* is definitely composite.
+*/
+template <typename UIntType> bool strong_lucas(const UIntType& n);
+
+/**
+* @brief Baillie-PSW probabilistic primality test
+*
+* @details Combines strong probable-prime test to base 2 with strong Lucas
+* test. Cost of the test is roughly 3 modular exponentiations and there is no
+* known composite passing it (it's proven there is none below \f$ 2^{64}
+* \f$). Test can be used as \c PrimarityTest for
+* Generators::random_prime_engine and Generators::next_prime.
+*
+* @tparam UIntType Unsigned integer type. Must be able to hold 2
+* times size of \c n, built-in types need to hold only \c n (see @ref native).
+*
+* @param n Number to be tested for primality. Must be greater than 3.
+*
+* @return \c true if number is probable prime, \c false if number
+* is definitely composite.
+*/
+template <typename UIntType> bool baillie_psw(const UIntType& n);
+
 /**
 * @brief Quick test, testing only first 1000 prime factors.
 *
 * @tparam UIntType Unsigned integer type.
 *
+* @details Same as f100_prime_factors, including fast path for built-in
+* types.
+*
 * @param n number to be tested for primarity
 *
 * @return \c true if no prime factor was found, \c false otherwise.
@@ -204,20 +795,62 @@ template <typename UIntType> bool f100_prime_factors(const UIntType& n);
 * together with other tests or for testing very small numbers.
 */
 template <typename UIntType> bool f1000_prime_factors(const UIntType& n);
-}
 
 /**
-* @brief Various arithmetic functions used in library algorithms
-*/
-namespace Utils {
-/**
-* @brief Factorize powers of 2 from n
+* @brief Quick test, testing first \c count prime factors
+*
+* @details Same as f100_prime_factors and f1000_prime_factors (which are
+* shortcuts for it), primes and inverses are generated at compile time for
+* any \c count (see KnownPrimes::first_primes).
 *
 * @tparam UIntType Unsigned integer type.
+* @tparam count number of tested primes
 *
-* @param n number to be factorized
+* @param n number to be tested for primarity
 *
-* @return std::pair (s, d) where s, d holds \f$ n = 2^{s} \times d \f$
+* @return \c true if no prime factor was found, \c false otherwise.
+* This test does not guarantee number to be prime, it should be used only
+* together with other tests or for testing very small numbers.
+*/
+template <typename UIntType, size_t count>
+bool first_prime_factors(const UIntType& n);
+
+/**
+* @brief Quick test, testing all prime factors up to \c bound
+*
+* @details Small primes are multiplied to word-size products and these to
+* bigger products (primorial split into chunks), computed once per \c UIntType
+* and \c bound. Candidate is reduced once per chunk and GCD with each word is
+* checked in built-in arithmetic, so only a handful of \c UIntType divisions
+* are needed even for big \c bound. For built-in types there is no gain over
+* f1000_prime_factors.
+*
+* @tparam UIntType Unsigned integer type. Must be able to hold product of 8
+* 64b numbers, if \c std::numeric_limits is not specialized for it.
+* @tparam bound all primes lower or equal to \c bound are tested
+*
+* @param n number to be tested for primarity
+*
+* @return \c true if no prime factor was found (except \c n itself), \c false
+* otherwise. This test does not guarantee number to be prime, it should be used
+* only together with other tests or for testing very small numbers.
+*/
+template <typename UIntType, uint_fast32_t bound = 7919>
+bool primorial_prime_factors(const UIntType& n);
+}
+
+/**
+* @brief Various arithmetic functions used in library algorithms
+*/
+namespace Utils {
+/**
+* @brief Factorize powers of 2 from n
+*
+* @tparam UIntType Unsigned integer type.
+*
+* @param n number to be factorized
+*
+* @return std::pair (s, d) where s, d holds \f$ n = 2^{s} \times d \f$
 */
 template <typename UIntType>
 std::pair<UIntType, UIntType> fac_2_powers(const UIntType& n);
@@ -228,7 +861,8 @@ std::pair<UIntType, UIntType> fac_2_powers(const UIntType& n);
 *
 * @tparam UIntType Unsigned integer type. Must be able to hold 2
 * times size of \c base and \c mod. (Even if \c base would fit in 32b type \c
-* UIntType must be able to hold 64b number.)
+* UIntType must be able to hold 64b number.) Built-in types need to hold only
+* \c mod, see @ref native.
 *
 * @param base base
 * @param exp exponent
@@ -239,15 +873,366 @@ std::pair<UIntType, UIntType> fac_2_powers(const UIntType& n);
 template <typename UIntType>
 UIntType pow_mod(UIntType base, UIntType exp, const UIntType& mod);
 
+/**
+* @brief Multiplication over a modulo
+*
+* @tparam UIntType Unsigned integer type. Must be able to hold 2
+* times size of \c mod, built-in types need to hold only \c mod (see @ref
+* native).
+*
+* @param a first factor, lower than \c mod
+* @param b second factor, lower than \c mod
+* @param mod modulo
+*
+* @return \f$ (a \times b) \% mod \f$
+*/
+template <typename UIntType>
+UIntType mul_mod(const UIntType& a, const UIntType& b, const UIntType& mod);
+
+/**
+* @brief Jacobi symbol \f$ (a / n) \f$
+*
+* @tparam UIntType Unsigned integer type.
+*
+* @param a any number
+* @param n odd modulo
+*
+* @return 1, -1 or 0 when \c a and \c n are not coprime
+*/
+template <typename UIntType> int jacobi(UIntType a, UIntType n);
+
+/**
+* @brief Integer square root
+*
+* @details Computed bit by bit, so only shifts, additions and subtractions are
+* used.
+*
+* @tparam UIntType Unsigned integer type.
+*
+* @param n number
+*
+* @return \f$ \lfloor \sqrt{n} \rfloor \f$
+*/
+template <typename UIntType> UIntType isqrt(const UIntType& n);
+
+/**
+* @brief Checks whether \c UIntType is built-in unsigned integer type handled
+* by Montgomery arithmetic
+*
+* @details Member constant \c value is \c true for 32b and 64b built-in
+* unsigned integer types (only 32b if \c unsigned \c __int128 is not
+* available). For such types library selects Montgomery arithmetic
+* automatically. Narrower types are promoted to \c int in expressions, so they
+* are not supported.
+*
+* @tparam UIntType Unsigned integer type.
+*/
+template <typename UIntType>
+struct is_native_uint
+    : std::integral_constant<
+          bool, std::is_integral<UIntType>::value &&
+                    std::is_unsigned<UIntType>::value &&
+                    (std::numeric_limits<UIntType>::digits == 32 ||
+                     (PRIMEGEN_HAS_UINT128 &&
+                      std::numeric_limits<UIntType>::digits == 64))> {};
+
+/**
+* @brief Arithmetic on \c UIntType used by library hot paths
+*
+* @details Customization point for number types. Default implementation uses
+* builtins for built-in types and only operators required from \c UIntType
+* otherwise (shifting by 16 bits at a time, see @ref bignums). Library
+* specializes it for PrimeGen::UInt and, in primegen_gmp.h, for \c mpz_class.
+* Other types may be supported faster by full specialization providing all
+* members.
+*
+* @tparam UIntType Unsigned integer type.
+*/
+template <typename UIntType> struct number_traits {
+  /// @return number of significant bits of \c n, 0 for 0
+  static size_t bit_length(const UIntType& n);
+  /// @return number of trailing zero bits of \c n, \c n must not be 0
+  static size_t trailing_zeros(const UIntType& n);
+  /// @return lowest 64 bits of \c n
+  static uint_fast64_t low_64(const UIntType& n);
+  /**
+  * @return highest 64 significant bits of \c n, ie. \f$ \lfloor n /
+  * 2^{bits - 64} \rfloor \f$ for \c n with more than 64 \c bits, \c n
+  * otherwise
+  */
+  static uint_fast64_t high_64(const UIntType& n);
+  /// @see Utils::mul_mod
+  static UIntType mul_mod(const UIntType& a, const UIntType& b,
+                          const UIntType& mod);
+  /// @see Utils::pow_mod
+  static UIntType pow_mod(UIntType base, UIntType exp, const UIntType& mod);
+};
+
+/**
+* @brief Montgomery arithmetic over odd modulo for built-in unsigned types
+*
+* @details Numbers are kept in Montgomery form \f$ a R \bmod n \f$, where \f$
+* R = 2^{32} \f$ or \f$ R = 2^{64} \f$. Multiplication needs only double-width
+* product and REDC reduction, there is no division and no overflow for any odd
+* modulo representable by \c UIntType.
+*
+* @tparam UIntType Unsigned integer type, Utils::is_native_uint must hold for
+* it.
+*/
+template <typename UIntType> class montgomery {
+  static_assert(is_native_uint<UIntType>::value,
+                "montgomery requires built-in unsigned integer type");
+
+public:
+  /// Type holding numbers in Montgomery form
+  typedef typename std::conditional<std::numeric_limits<UIntType>::digits <=
+                                        32,
+                                    uint32_t, uint64_t>::type word_type;
+#if PRIMEGEN_HAS_UINT128
+  /// Type holding double-width products
+  typedef typename std::conditional<std::numeric_limits<UIntType>::digits <=
+                                        32,
+                                    uint64_t, unsigned __int128>::type
+      wide_type;
+#else
+  /// Type holding double-width products
+  typedef uint64_t wide_type;
+#endif
+
+  /**
+  * @brief Prepares Montgomery arithmetic for modulo \c mod
+  *
+  * @param mod modulo, must be odd
+  */
+  explicit montgomery(const UIntType& mod);
+
+  /**
+  * @brief Converts number to Montgomery form
+  *
+  * @param a number to convert, may be greater than modulo
+  * @return \f$ a R \bmod n \f$
+  */
+  word_type to_form(const UIntType& a) const;
+  /**
+  * @brief Converts number from Montgomery form
+  *
+  * @param a number in Montgomery form
+  * @return \f$ a R^{-1} \bmod n \f$
+  */
+  UIntType from_form(word_type a) const;
+  /**
+  * @brief Multiplication in Montgomery form
+  *
+  * @return \f$ a b R^{-1} \bmod n \f$
+  */
+  word_type mul(word_type a, word_type b) const {
+    return reduce(wide_type(a) * b);
+  }
+  /**
+  * @brief Exponentiation in Montgomery form by repeated squaring
+  *
+  * @param base base in Montgomery form
+  * @param exp exponent (not in Montgomery form)
+  * @return \f$ {base}^{exp} \f$ in Montgomery form
+  */
+  word_type pow(word_type base, UIntType exp) const;
+  /// @return 1 in Montgomery form
+  word_type one() const { return one_; }
+  /// @return modulo
+  word_type mod() const { return mod_; }
+
+private:
+  word_type reduce(wide_type t) const;
+
+  word_type mod_;
+  word_type mod_inv_; // mod^{-1} mod R
+  word_type one_;     // R mod n
+  word_type r2_;      // R^2 mod n
+};
+
+/**
+* @brief Strong probable-prime test (one round of Miller-Rabin test)
+*
+* @details Precomputes everything needed for testing given number \c n, so
+* testing for several bases is cheap. Montgomery arithmetic is used for
+* built-in types (see Utils::is_native_uint).
+*
+* @tparam UIntType Unsigned integer type. Must be able to hold 2
+* times size of \c n, built-in types need to hold only \c n.
+*/
+template <typename UIntType, bool = is_native_uint<UIntType>::value>
+class strong_probable_prime {
+public:
+  /**
+  * @param n Number to be tested. Must be odd (Montgomery form needs odd
+  * modulo) and greater than 3.
+  */
+  explicit strong_probable_prime(const UIntType& n);
+
+  /**
+  * @brief Tests \c n to base \c witness
+  *
+  * @param witness base of test in [2, n-1]
+  *
+  * @return \c false if \c witness proves \c n is composite, \c true
+  * otherwise
+  */
+  bool operator()(const UIntType& witness) const;
+
+private:
+  UIntType n_;
+  UIntType n_minus_1_;
+  std::pair<UIntType, UIntType> factors_; // n - 1 = 2^first * second
+};
+
+/// @cond
+template <typename UIntType> class strong_probable_prime<UIntType, true> {
+public:
+  explicit strong_probable_prime(const UIntType& n);
+  bool operator()(const UIntType& witness) const;
+
+private:
+  typedef typename montgomery<UIntType>::word_type word_type;
+
+  montgomery<UIntType> mont_;
+  word_type minus_one_;                   // n - 1 in Montgomery form
+  std::pair<UIntType, UIntType> factors_; // n - 1 = 2^first * second
+};
+/// @endcond
+
+/**
+* @brief Sieve of odd prime candidates
+*
+* @details Enumerates odd numbers \c start, \c start + 2, ... which are not
+* divisible by any of first \c primes_count primes (except prime itself).
+* Residues of \c start modulo small primes are computed only once, candidates
+* are then sieved in windows of \c window odd numbers and residues are moved
+* to next window by word-size additions. No operation on \c UIntType is
+* needed for rejected candidates.
+*
+* @tparam UIntType Unsigned integer type.
+* @tparam window Number of odd candidates sieved at once
+* @tparam primes_count Number of sieving primes (see
+* KnownPrimes::first_primes), deeper sieving pays off for bigger numbers
+*/
+template <typename UIntType, uint_fast32_t window = 4096,
+          size_t primes_count = 1000>
+class candidate_sieve {
+public:
+  /**
+  * @param start first candidate, must be odd
+  */
+  explicit candidate_sieve(const UIntType& start);
+
+  /**
+  * @brief Finds next candidate without small prime factors
+  *
+  * @return candidates in increasing order, each is returned once
+  */
+  UIntType next();
+
+  /**
+  * @brief Finds next candidate without small prime factors in current window
+  *
+  * @param candidate found candidate
+  *
+  * @return \c false if there are no more candidates in current window
+  */
+  bool next_in_window(UIntType& candidate);
+
+  /**
+  * @brief Moves sieve forward by \c windows windows
+  *
+  * @details Residues are moved by word-size arithmetic, so distant windows
+  * can be sieved cheaply (e.g. by several threads from one copied sieve).
+  *
+  * @param windows number of windows to skip, skipping 1 window moves to the
+  * next one
+  */
+  void skip(uint_fast64_t windows);
+
+  /**
+  * @brief Rejects candidates congruent to \c residue modulo \c modulus
+  *
+  * @details Constraint is applied in the sieve together with small primes,
+  * so rejected candidates cost no operation on \c UIntType. Current window
+  * is sieved again, candidates already returned are not affected.
+  *
+  * @param modulus odd modulus
+  * @param residue rejected residue, lower than \c modulus
+  */
+  void exclude(uint_fast32_t modulus, uint_fast32_t residue);
+
+private:
+  typedef std::array<uint_fast32_t, primes_count> primes_type;
+
+  struct exclusion {
+    uint_fast64_t modulus;
+    uint_fast64_t residue;
+    uint_fast64_t base_residue; // base_ modulo modulus
+  };
+
+  void sieve();
+
+  UIntType base_;            // first candidate of current window
+  uint_fast32_t small_base_; // base_ if it's lower than sieving primes, else 0
+  uint_fast32_t position_;   // index of next candidate in current window
+  primes_type residues_; // base_ modulo sieving primes
+  std::array<bool, window> composite_;
+  std::vector<exclusion> exclusions_;
+};
+
+/**
+* @brief Sieve of Sophie Germain prime candidates
+*
+* @details Enumerates odd numbers \c q from \c start, such that neither \c q
+* nor \f$ 2q + 1 \f$ is divisible by any of first \c primes_count primes.
+* Works as candidate_sieve, only two residue classes are crossed off for each
+* prime \f$ r \f$ (\f$ q \equiv 0 \f$ and \f$ q \equiv (r - 1) / 2 \pmod{r}
+* \f$).
+*
+* @tparam UIntType Unsigned integer type.
+* @tparam window Number of odd candidates sieved at once
+* @tparam primes_count Number of sieving primes
+*/
+template <typename UIntType, uint_fast32_t window = 4096,
+          size_t primes_count = 1000>
+class safe_candidate_sieve {
+public:
+  /**
+  * @param start first candidate, must be odd and greater than the largest
+  * sieving prime
+  */
+  explicit safe_candidate_sieve(const UIntType& start);
+
+  /**
+  * @brief Finds next candidate \c q without small prime factors in \c q and
+  * \f$ 2q + 1 \f$
+  *
+  * @return candidates in increasing order, each is returned once
+  */
+  UIntType next();
+
+private:
+  typedef std::array<uint_fast32_t, primes_count> primes_type;
+
+  void sieve();
+
+  UIntType base_;          // first candidate of current window
+  uint_fast32_t position_; // index of next candidate in current window
+  primes_type residues_;   // base_ modulo sieving primes
+  std::array<bool, window> composite_;
+};
+
 /**
 * @brief Logarithm function
 *
 * @details Computes logarithm with maximum precision avaible for
-* standard types. \c UIntType must be able to print itself to stream (ie.
-* stream operator << must be defined)
+* standard types. Only the highest 64 significant bits of \c n are used.
 *
 * @tparam UIntType Unsigned integer type.
-* @tparam w size of \b n in bits
+* @tparam w size of \b n in bits (0 for unbounded types), unused since actual
+* size of \c n is computed
 *
 * @param n number to compute logarithm for
 * @return natural logarithm of n
@@ -275,6 +1260,78 @@ template <typename UIntType, size_t w> double log(const UIntType& n);
 */
 template <typename UIntType, typename EngineType, size_t w>
 UIntType independent_bits_generator(EngineType& _32b_generator);
+
+/**
+* @brief Counters of prime search pipeline
+*
+* @details Filled by thread_stats. Candidates of a search are all odd numbers
+* from its start to the found prime, those not rejected by the sieve are passed
+* to primality test. Test accepting a prime runs all its rounds (e.g. all \c
+* accuracy rounds of Tests::miller_rabin), while composites are mostly
+* rejected by the first round, so cycles per test of these two groups show the
+* cost of rounds.
+*/
+struct search_stats {
+  uint_fast64_t searches = 0;   ///< number of found primes
+  uint_fast64_t candidates = 0; ///< odd numbers covered by searches
+  uint_fast64_t tests = 0;      ///< candidates not rejected by the sieve
+  /// cycles outside of primality tests (random numbers, sieving)
+  uint_fast64_t sieve_cycles = 0;
+  /// cycles of primality tests rejecting a candidate
+  uint_fast64_t rejecting_test_cycles = 0;
+  /// cycles of primality tests accepting a candidate
+  uint_fast64_t accepting_test_cycles = 0;
+};
+
+/**
+* @brief Statistics policy recording nothing
+*
+* @details Default \c Stats policy of Generators::random_prime_engine and
+* Generators::next_prime, all calls are optimized out. Custom policy (e.g.
+* exporting directly to a metrics system) must provide the same static
+* members as this one.
+*/
+struct no_stats {
+  /// whether the policy records anything
+  static constexpr bool enabled = false;
+  /// @return current cycle counter
+  static uint_fast64_t now() { return 0; }
+  /// @brief Records one primality test which took \c cycles
+  static void record_test(bool accepted, uint_fast64_t cycles) {
+    (void)accepted;
+    (void)cycles;
+  }
+  /// @brief Records one finished search over \c candidates odd numbers
+  static void record_search(uint_fast64_t candidates,
+                            uint_fast64_t sieve_cycles) {
+    (void)candidates;
+    (void)sieve_cycles;
+  }
+};
+
+/**
+* @brief Statistics policy recording to per-thread counters
+*
+* @details Every thread has its own search_stats counters, they are updated
+* only by the owning thread without any locking (as relaxed atomics, so other
+* threads may read them). Cycles are read from time stamp counter on x86 and
+* are nanoseconds of \c std::chrono::steady_clock elsewhere. Counters of
+* exited threads stay included in total().
+*
+* @see no_stats
+*/
+struct thread_stats {
+  static constexpr bool enabled = true;
+  static uint_fast64_t now();
+  static void record_test(bool accepted, uint_fast64_t cycles);
+  static void record_search(uint_fast64_t candidates,
+                            uint_fast64_t sieve_cycles);
+
+  /// @return counters of calling thread
+  static search_stats local();
+  /// @return sum of counters of all threads
+  static search_stats total();
+};
 }
 
 // prepared generators for convenience
@@ -327,164 +1384,2193 @@ using pseudo_random_prime_engine = random_prime_engine<
 /* IMPLEMENTATION */
 
 namespace PrimeGen {
-namespace Generators {
-template <typename UIntType, size_t w, typename RandomNumberEngine,
-          bool (&PrimarityTest)(const UIntType&)>
-inline auto random_prime_engine<UIntType, w, RandomNumberEngine,
-                                PrimarityTest>::
-operator()() -> result_type {
-  UIntType prime_candidate =
-      Utils::independent_bits_generator<UIntType, RandomNumberEngine, w>(e_);
-  prime_candidate = prime_candidate | 1; // we need odd number
-  while (true) {
-    prime_candidate = prime_candidate + 2;
-    prime_candidate = prime_candidate | (1u << (w - 1)); // we want big primes
-    if (Tests::f1000_prime_factors(prime_candidate) &&
-        PrimarityTest(prime_candidate)) {
-      return prime_candidate;
+namespace Details {
+template <typename UIntType>
+UIntType pow_mod(UIntType base, UIntType exp, const UIntType& mod,
+                 std::false_type) {
+  UIntType result = 1;
+  while (exp > 0) {
+    if ((exp & 1) == 1) // if odd
+    {
+      result = (result * base) % mod;
     }
+    base = (base * base) % mod;
+    exp = exp >> 1;
   }
+  return result;
 }
 
-template <typename UIntType, size_t accuracy> UIntType next_prime(UIntType n) {
-  n = n | 1;
-  while (true) {
-    n = n + 2;
-    if (Tests::f1000_prime_factors(n) &&
-        Tests::miller_rabin<UIntType, accuracy>(n)) {
-      return n;
+// Montgomery multiplication (CIOS) of numbers of size limbs, R = 2^(size *
+// limb_digits), used for modular exponentiation of UInt without divisions
+template <size_t max_size> class limb_montgomery {
+public:
+  limb_montgomery(const limb_type* mod, size_t size)
+      : mod_(mod), size_(size) {
+    // -mod^{-1} mod 2^limb_digits by Newton's iteration
+    limb_type inverse = mod[0];
+    for (int i = 0; i < 6; ++i) {
+      inverse *= 2 - mod[0] * inverse;
     }
+    mod_inv_ = 0 - inverse;
   }
-}
-}
 
-namespace Tests {
-template <typename UIntType, size_t accuracy>
-bool miller_rabin(const UIntType& n) {
-  std::random_device rd;
-  UIntType witness = rd();
-  std::pair<UIntType, UIntType> factors = Utils::fac_2_powers<UIntType>(
-      n - 1); // factors in format 2^first * second
-  for (size_t i = 0; i < accuracy; ++i) {
-    // @todo check if we are getting something close to uniform distribution
-    witness = ((witness * 48271) % (n - 4)) +
-              2; // generates witnesses from interval [2, n-2]
-    UIntType x = Utils::pow_mod(witness, factors.second, n);
-    if (x == 1 || x == n - 1) {
-      continue;
+  // result = a * b / R mod n, a and b lower than n, result may alias them
+  void mul(const limb_type* a, const limb_type* b, limb_type* result) {
+    limb_type* t = work_;
+    std::fill(t, t + size_ + 2, 0);
+    for (size_t i = 0; i < size_; ++i) {
+      limb_type carry = 0;
+      for (size_t j = 0; j < size_; ++j) {
+        double_limb_type sum = double_limb_type(a[j]) * b[i] + t[j] + carry;
+        t[j] = static_cast<limb_type>(sum);
+        carry = static_cast<limb_type>(sum >> limb_digits);
+      }
+      double_limb_type top = double_limb_type(t[size_]) + carry;
+      t[size_] = static_cast<limb_type>(top);
+      t[size_ + 1] = static_cast<limb_type>(top >> limb_digits);
+
+      // add m * n, so lowest limb becomes 0, and shift by one limb
+      limb_type m = t[0] * mod_inv_;
+      double_limb_type sum = double_limb_type(m) * mod_[0] + t[0];
+      carry = static_cast<limb_type>(sum >> limb_digits);
+      for (size_t j = 1; j < size_; ++j) {
+        sum = double_limb_type(m) * mod_[j] + t[j] + carry;
+        t[j - 1] = static_cast<limb_type>(sum);
+        carry = static_cast<limb_type>(sum >> limb_digits);
+      }
+      sum = double_limb_type(t[size_]) + carry;
+      t[size_ - 1] = static_cast<limb_type>(sum);
+      t[size_] = t[size_ + 1] + static_cast<limb_type>(sum >> limb_digits);
     }
-    for (UIntType j = 1; j < factors.first; ++j) {
-      x = (x * x) % n;
-      if (x == 1 || x == n - 1) {
+    // t < 2n, subtract n once if needed
+    bool subtract = t[size_] != 0;
+    for (size_t i = size_; !subtract && i-- > 0;) {
+      if (t[i] != mod_[i]) {
+        subtract = t[i] > mod_[i];
         break;
       }
+      subtract = i == 0; // t == n
     }
-    if (x != n - 1) {
-      return false;
+    limb_type borrow = 0;
+    for (size_t i = 0; i < size_; ++i) {
+      limb_type subtrahend = subtract ? mod_[i] : 0;
+      limb_type digit = t[i];
+      result[i] = digit - subtrahend - borrow;
+      borrow = (digit < subtrahend || (digit == subtrahend && borrow)) ? 1 : 0;
     }
   }
-  return true;
-}
-
-template <typename UIntType, size_t w>
-bool miller_rabin_deterministic(const UIntType& n) {
-  UIntType witness;
-  std::pair<UIntType, UIntType> factors = Utils::fac_2_powers<UIntType>(
-      n - 1); // factors in format 2^first * second
 
-  // check for all generators of (Z/nZ)* (witness for n must be one of them)
-  // according to GRH, generators must be in [2, min(n-1, floor(2* (ln n)^2))]
-  double n_log = Utils::log<UIntType, w>(n);
-  UIntType upper_bound = static_cast<UIntType>(2 * n_log * n_log);
-  upper_bound = (n - 1) < upper_bound ? n - 1 : upper_bound;
+private:
+  const limb_type* mod_;
+  size_t size_;
+  limb_type mod_inv_; // -mod^{-1} mod 2^limb_digits
+  limb_type work_[max_size + 2];
+};
 
-  for (witness = 2; witness <= upper_bound; ++witness) {
-    UIntType x = Utils::pow_mod(witness, factors.second, n);
-    if (x == 1 || x == n - 1) {
-      continue;
-    }
-    for (UIntType j = 1; j < factors.first; ++j) {
-      x = (x * x) % n;
-      if (x == 1 || x == n - 1) {
-        break;
+// odd modulo is handled in Montgomery form when R = 2^(limbs of mod) can be
+// represented, otherwise as for other types
+template <size_t Bits>
+UInt<Bits> pow_mod(UInt<Bits> base, UInt<Bits> exp, const UInt<Bits>& mod,
+                   std::false_type) {
+  constexpr size_t limbs = UInt<Bits>::limbs;
+  size_t size = (mod.bit_length() + limb_digits - 1) / limb_digits;
+  if ((mod & 1) == 0 || 2 * size > limbs || mod == 1) {
+    UInt<Bits> result = 1;
+    while (exp > 0) {
+      if ((exp & 1) == 1) {
+        result = (result * base) % mod;
       }
+      base = (base * base) % mod;
+      exp = exp >> 1;
     }
-    if (x != n - 1) {
-      return false;
-    }
+    return result;
   }
-  return true;
-}
-
-template <typename UIntType> bool f100_prime_factors(const UIntType& n) {
-  for (size_t i : KnownPrimes::first_100_primes) {
-    if (n % i == 0 && n != i) {
-      return false;
+  limb_type mod_limbs[limbs] = {};
+  for (size_t i = 0; i < size; ++i) {
+    mod_limbs[i] = mod.limb(i);
+  }
+  limb_montgomery<limbs / 2> mont(mod_limbs, size);
+  // base * R mod n
+  UInt<Bits> base_form = ((base % mod) << (size * limb_digits)) % mod;
+  UInt<Bits> one_form = (UInt<Bits>(1) << (size * limb_digits)) % mod;
+  limb_type b[limbs];
+  limb_type x[limbs];
+  for (size_t i = 0; i < size; ++i) {
+    b[i] = base_form.limb(i);
+    x[i] = one_form.limb(i);
+  }
+  for (size_t bit = exp.bit_length(); bit-- > 0;) {
+    mont.mul(x, x, x);
+    if ((exp.limb(bit / limb_digits) >> (bit % limb_digits)) & 1) {
+      mont.mul(x, b, x);
     }
   }
-  return true;
+  // from Montgomery form
+  limb_type one[limbs] = { 1 };
+  mont.mul(x, one, x);
+  UInt<Bits> result;
+  for (size_t i = 0; i < size; ++i) {
+    result.limb(i) = x[i];
+  }
+  return result;
 }
 
-template <typename UIntType> bool f1000_prime_factors(const UIntType& n) {
-  for (size_t i : KnownPrimes::first_1000_primes) {
-    if (n % i == 0 && n != i) {
+template <typename UIntType>
+UIntType pow_mod(UIntType base, UIntType exp, const UIntType& mod,
+                 std::true_type) {
+  typedef Utils::montgomery<UIntType> montgomery_type;
+  if ((mod & 1) == 1) {
+    montgomery_type mont(mod);
+    return mont.from_form(mont.pow(mont.to_form(base), exp));
+  }
+  // Montgomery form needs odd modulo, use plain double-width products
+  typedef typename montgomery_type::wide_type wide_type;
+  wide_type result = 1 % mod;
+  wide_type b = base % mod;
+  while (exp > 0) {
+    if ((exp & 1) == 1) // if odd
+    {
+      result = (result * b) % mod;
+    }
+    b = (b * b) % mod;
+    exp = exp >> 1;
+  }
+  return static_cast<UIntType>(result);
+}
+
+template <typename UIntType>
+UIntType mul_mod(const UIntType& a, const UIntType& b, const UIntType& mod,
+                 std::false_type) {
+  return (a * b) % mod;
+}
+
+template <typename UIntType>
+UIntType mul_mod(const UIntType& a, const UIntType& b, const UIntType& mod,
+                 std::true_type) {
+  typedef typename Utils::montgomery<UIntType>::wide_type wide_type;
+  return static_cast<UIntType>(wide_type(a) * b % mod);
+}
+
+// modular addition and subtraction of numbers lower than mod, without
+// overflowing mod
+template <typename UIntType>
+UIntType add_mod(const UIntType& a, const UIntType& b, const UIntType& mod) {
+  UIntType rest = mod - b;
+  if (a < rest) {
+    return a + b;
+  }
+  return a - rest;
+}
+
+template <typename UIntType>
+UIntType sub_mod(const UIntType& a, const UIntType& b, const UIntType& mod) {
+  if (a < b) {
+    return a + (mod - b);
+  }
+  return a - b;
+}
+
+// lowest 64 bits converted to built-in type, default for
+// Utils::number_traits::low_64, overloads are ranked by conversion_rank
+struct conversion_generic {};
+struct conversion_get_ui : conversion_generic {};
+struct conversion_rank : conversion_get_ui {};
+
+template <typename UIntType>
+auto low_64(const UIntType& n, conversion_rank) -> typename std::enable_if<
+    std::is_integral<UIntType>::value, uint_fast64_t>::type {
+  return static_cast<uint_fast64_t>(n);
+}
+
+// types providing get_ui() with 64b result, e.g. mpz_class
+template <typename UIntType>
+auto low_64(const UIntType& n, conversion_get_ui) -> typename std::enable_if<
+    std::numeric_limits<decltype(n.get_ui())>::digits >= 64,
+    uint_fast64_t>::type {
+  return n.get_ui();
+}
+
+template <typename UIntType>
+uint_fast64_t low_64(UIntType n, conversion_generic) {
+  // only operators required from UIntType can be used
+  uint_fast64_t result = 0;
+  for (uint_fast64_t bit = 1; bit != 0 && n != 0; bit <<= 1) {
+    if ((n & 1) == 1) {
+      result |= bit;
+    }
+    n = n >> 1;
+  }
+  return result;
+}
+
+// conversion of small numbers (lower than 2^64) to built-in type
+template <typename UIntType> uint_fast64_t to_uint_fast64(const UIntType& n) {
+  return Utils::number_traits<UIntType>::low_64(n);
+}
+
+// all primes lower or equal to bound, simple sieve of Eratosthenes
+inline std::vector<uint_fast32_t> sieve_primes(uint_fast32_t bound) {
+  std::vector<bool> composite(bound + 1, false);
+  std::vector<uint_fast32_t> primes;
+  for (uint_fast64_t i = 2; i <= bound; ++i) {
+    if (composite[i]) {
+      continue;
+    }
+    primes.push_back(static_cast<uint_fast32_t>(i));
+    for (uint_fast64_t j = i * i; j <= bound; j += i) {
+      composite[j] = true;
+    }
+  }
+  return primes;
+}
+
+// index of lowest set bit, n must not be 0
+inline int count_trailing_zeros(uint_fast64_t n) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(n);
+#else
+  int count = 0;
+  for (; (n & 1) == 0; n >>= 1) {
+    ++count;
+  }
+  return count;
+#endif
+}
+
+// number of set bits
+inline int population_count(uint_fast64_t n) {
+#if defined(__GNUC__)
+  return __builtin_popcountll(n);
+#else
+  int count = 0;
+  for (; n != 0; n &= n - 1) {
+    ++count;
+  }
+  return count;
+#endif
+}
+
+// number of significant bits, 0 for 0
+inline int bit_length_64(uint_fast64_t n) {
+#if defined(__GNUC__)
+  return n == 0 ? 0 : 64 - __builtin_clzll(n);
+#else
+  int count = 0;
+  for (; n != 0; n >>= 1) {
+    ++count;
+  }
+  return count;
+#endif
+}
+
+// defaults for Utils::number_traits, overloads taking std::true_type are for
+// built-in types up to 64 bits
+template <typename UIntType>
+using is_builtin_64 =
+    std::integral_constant<bool, std::is_integral<UIntType>::value &&
+                                     std::numeric_limits<UIntType>::digits <=
+                                         64>;
+
+template <typename UIntType>
+size_t bit_length(const UIntType& n, std::true_type) {
+  return bit_length_64(n);
+}
+
+template <typename UIntType>
+size_t bit_length(const UIntType& n, std::false_type) {
+  // shifts by 16 are valid even for narrow types
+  size_t bits = 0;
+  UIntType rest = n;
+  for (UIntType high = rest >> 16; high != 0; high = rest >> 16) {
+    rest = high;
+    bits += 16;
+  }
+  for (; rest != 0; rest = rest >> 1) {
+    ++bits;
+  }
+  return bits;
+}
+
+template <typename UIntType>
+size_t trailing_zeros(const UIntType& n, std::true_type) {
+  return count_trailing_zeros(n);
+}
+
+template <typename UIntType>
+size_t trailing_zeros(const UIntType& n, std::false_type) {
+  size_t zeros = 0;
+  UIntType rest = n;
+  while ((rest & 0xffff) == 0) {
+    rest = rest >> 16;
+    zeros += 16;
+  }
+  return zeros + count_trailing_zeros(low_64<UIntType>(
+                     rest & 0xffff, conversion_rank()));
+}
+
+// number of threads to use, 0 means all hardware threads
+inline unsigned thread_count(unsigned threads) {
+  if (threads == 0) {
+    threads = std::thread::hardware_concurrency();
+  }
+  return threads == 0 ? 1 : threads;
+}
+
+// runs f(0), ..., f(threads - 1) concurrently, f(0) in calling thread
+template <typename Function> void run_parallel(unsigned threads, Function f) {
+  std::vector<std::thread> workers;
+  workers.reserve(threads - 1);
+  for (unsigned t = 1; t < threads; ++t) {
+    workers.emplace_back(f, t);
+  }
+  f(0);
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+}
+
+// engine used for Miller-Rabin witnesses when caller does not supply one,
+// seeded from std::random_device once per thread
+inline std::mt19937& witness_engine() {
+  static thread_local std::mt19937 engine = [] {
+    std::random_device rd;
+    std::seed_seq sequence{ rd(), rd(), rd(), rd() };
+    return std::mt19937(sequence);
+  }();
+  return engine;
+}
+
+// uniformly distributed random number from [lo, hi]
+template <typename UIntType, typename Engine>
+UIntType uniform_random(const UIntType& lo, const UIntType& hi, Engine& engine,
+                        std::true_type) {
+  return std::uniform_int_distribution<UIntType>(lo, hi)(engine);
+}
+
+// 64 bits more than needed are generated, so bias of modulo is below 2^-64
+template <typename UIntType, typename Engine>
+UIntType uniform_random(const UIntType& lo, const UIntType& hi, Engine& engine,
+                        std::false_type) {
+  std::uniform_int_distribution<uint_fast32_t> word(0, 0xffffffff);
+  UIntType range = hi - lo + 1;
+  UIntType random = 0;
+  for (UIntType rest = range; rest != 0; rest = rest >> 32) {
+    random = (random << 32) + UIntType(word(engine));
+  }
+  for (int i = 0; i < 2; ++i) {
+    random = (random << 32) + UIntType(word(engine));
+  }
+  return lo + random % range;
+}
+
+// index-th item of batch generated by engine seeded by seed, engines are
+// constructed in place as some (std::random_device) can't be moved
+template <typename Engine>
+typename Engine::result_type generate_seeded(uint_fast64_t seed,
+                                             uint_fast64_t index,
+                                             std::true_type) {
+  std::seed_seq sequence{ static_cast<uint_least32_t>(seed),
+                          static_cast<uint_least32_t>(seed >> 32),
+                          static_cast<uint_least32_t>(index),
+                          static_cast<uint_least32_t>(index >> 32) };
+  Engine engine(sequence);
+  return engine();
+}
+
+template <typename Engine>
+typename Engine::result_type generate_seeded(uint_fast64_t, uint_fast64_t,
+                                             std::false_type) {
+  Engine engine;
+  return engine();
+}
+
+// primality test recorded by Stats policy, cycles of test are added to cycles
+template <typename Stats, typename UIntType,
+          bool (&PrimarityTest)(const UIntType&)>
+inline bool timed_test(const UIntType& n, uint_fast64_t& cycles) {
+  uint_fast64_t start = Stats::now();
+  bool accepted = PrimarityTest(n);
+  uint_fast64_t test_cycles = Stats::now() - start;
+  Stats::record_test(accepted, test_cycles);
+  cycles += test_cycles;
+  return accepted;
+}
+
+// search from first to found prime recorded by Stats policy, candidates are
+// counted only if the policy is enabled
+template <typename Stats, typename UIntType>
+void record_search(const UIntType& first, const UIntType& prime,
+                   uint_fast64_t sieve_cycles, std::true_type) {
+  Stats::record_search(
+      to_uint_fast64<UIntType>(UIntType((prime - first) >> 1)) + 1,
+      sieve_cycles);
+}
+
+template <typename Stats, typename UIntType>
+void record_search(const UIntType&, const UIntType&, uint_fast64_t,
+                   std::false_type) {}
+
+template <typename Stats, typename UIntType>
+void record_search(const UIntType& first, const UIntType& prime,
+                   uint_fast64_t sieve_cycles) {
+  record_search<Stats>(first, prime, sieve_cycles,
+                       std::integral_constant<bool, Stats::enabled>());
+}
+
+enum stats_counter {
+  stats_searches,
+  stats_candidates,
+  stats_tests,
+  stats_sieve_cycles,
+  stats_rejecting_test_cycles,
+  stats_accepting_test_cycles,
+  stats_counters
+};
+
+typedef std::array<uint_fast64_t, stats_counters> stats_values;
+
+inline Utils::search_stats to_search_stats(const stats_values& values) {
+  Utils::search_stats stats;
+  stats.searches = values[stats_searches];
+  stats.candidates = values[stats_candidates];
+  stats.tests = values[stats_tests];
+  stats.sieve_cycles = values[stats_sieve_cycles];
+  stats.rejecting_test_cycles = values[stats_rejecting_test_cycles];
+  stats.accepting_test_cycles = values[stats_accepting_test_cycles];
+  return stats;
+}
+
+// counters of one thread for Utils::thread_stats, registered while the thread
+// is alive, written only by the owning thread
+class thread_counters {
+public:
+  thread_counters() {
+    for (std::atomic<uint_fast64_t>& value : values_) {
+      value.store(0, std::memory_order_relaxed);
+    }
+    registry& r = get_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.threads.push_back(this);
+  }
+
+  ~thread_counters() {
+    registry& r = get_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    stats_values values = get();
+    for (size_t i = 0; i < stats_counters; ++i) {
+      r.retired[i] += values[i];
+    }
+    r.threads.erase(std::find(r.threads.begin(), r.threads.end(), this));
+  }
+
+  void add(stats_counter counter, uint_fast64_t value) {
+    std::atomic<uint_fast64_t>& target = values_[counter];
+    target.store(target.load(std::memory_order_relaxed) + value,
+                 std::memory_order_relaxed);
+  }
+
+  stats_values get() const {
+    stats_values values;
+    for (size_t i = 0; i < stats_counters; ++i) {
+      values[i] = values_[i].load(std::memory_order_relaxed);
+    }
+    return values;
+  }
+
+  static thread_counters& local() {
+    static thread_local thread_counters counters;
+    return counters;
+  }
+
+  // counters of all alive and exited threads
+  static stats_values total() {
+    registry& r = get_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    stats_values values = r.retired;
+    for (const thread_counters* thread : r.threads) {
+      stats_values thread_values = thread->get();
+      for (size_t i = 0; i < stats_counters; ++i) {
+        values[i] += thread_values[i];
+      }
+    }
+    return values;
+  }
+
+private:
+  struct registry {
+    std::mutex mutex;
+    std::vector<const thread_counters*> threads;
+    stats_values retired{};
+  };
+
+  static registry& get_registry() {
+    static registry r;
+    return r;
+  }
+
+  std::atomic<uint_fast64_t> values_[stats_counters];
+};
+
+// mod 30 wheel, byte of sieve represents 30 numbers, bit i represents number
+// with residue wheel30[i]
+constexpr uint_fast8_t wheel30[8] = { 1, 7, 11, 13, 17, 19, 23, 29 };
+// distances between consecutive wheel30 numbers
+constexpr uint_fast8_t wheel30_gaps[8] = { 6, 4, 2, 4, 2, 4, 6, 2 };
+// index of first wheel30 number greater or equal to residue
+constexpr uint_fast8_t wheel30_next[30] = { 0, 0, 1, 1, 1, 1, 1, 1, 2, 2,
+                                             2, 2, 3, 3, 4, 4, 4, 4, 5, 5,
+                                             6, 6, 6, 6, 7, 7, 7, 7, 7, 7 };
+// for prime p = 30q + wheel30[r] and its multiple p * k, k = 30a + wheel30[i]:
+// bit representing p * k in its byte
+constexpr uint_fast8_t wheel30_multiple_bit[8][8] = {
+  { 1, 2, 4, 8, 16, 32, 64, 128 },   { 2, 32, 16, 1, 128, 8, 4, 64 },
+  { 4, 16, 1, 64, 2, 128, 8, 32 },   { 8, 1, 64, 32, 4, 2, 128, 16 },
+  { 16, 128, 2, 4, 32, 64, 1, 8 },   { 32, 8, 128, 2, 64, 1, 16, 4 },
+  { 64, 4, 8, 128, 1, 16, 32, 2 },   { 128, 64, 32, 16, 8, 4, 2, 1 }
+};
+// bytes to next multiple p * (k + wheel30_gaps[i]) are q * wheel30_gaps[i] +
+// wheel30_multiple_carry[r][i]
+constexpr uint_fast8_t wheel30_multiple_carry[8][8] = {
+  { 0, 0, 0, 0, 0, 0, 0, 1 }, { 1, 1, 1, 0, 1, 1, 1, 1 },
+  { 2, 2, 0, 2, 0, 2, 2, 1 }, { 3, 1, 1, 2, 1, 1, 3, 1 },
+  { 3, 3, 1, 2, 1, 3, 3, 1 }, { 4, 2, 2, 2, 2, 2, 4, 1 },
+  { 5, 3, 1, 4, 1, 3, 5, 1 }, { 6, 4, 2, 4, 2, 4, 6, 1 }
+};
+
+// primes from 7 to sqrt(hi - 1) for sieving range below hi
+inline std::vector<uint_fast32_t> sieving_primes(uint_fast64_t hi);
+
+// segmented sieve of Eratosthenes with mod 30 wheel, segments are sieved in
+// increasing order from segment containing low
+class wheel_sieve {
+public:
+  static constexpr size_t segment_bytes = 32768;
+  // numbers in one work item of parallel sieving
+  static constexpr uint_fast64_t parallel_block = 16 * 30 * segment_bytes;
+
+  wheel_sieve(uint_fast64_t low, uint_fast64_t high,
+              const std::vector<uint_fast32_t>& primes)
+      : segment_low_(low - low % 30), next_low_(segment_low_), high_(high),
+        segment_(segment_bytes) {
+    multiples_.reserve(primes.size());
+    for (uint_fast32_t p : primes) {
+      if (p <= presieve_max) {
+        continue;
+      }
+      // first multiple p * k >= max(p * p, low) with k coprime to 30
+      uint_fast64_t k = std::max<uint_fast64_t>(p, (segment_low_ + p - 1) / p);
+      uint_fast64_t k_base = k - k % 30;
+      uint_fast8_t index = wheel30_next[k % 30];
+      uint_fast64_t value = p * (k_base + wheel30[index]);
+      multiples_.push_back({ (value - segment_low_) / 30, p / 30,
+                             wheel30_next[p % 30], index });
+    }
+  }
+
+  // sieves next segment, returns false when whole range is done
+  bool next_segment() {
+    if (next_low_ >= high_) {
+      return false;
+    }
+    segment_low_ = next_low_;
+    uint_fast64_t segment_high = segment_low_ + 30 * segment_bytes;
+    // multiples of small primes are copied from periodic pattern
+    const std::vector<uint_fast8_t>& pattern = presieve_pattern();
+    size_t offset = (segment_low_ / 30) % pattern.size();
+    for (size_t byte = 0; byte < segment_bytes;) {
+      size_t length =
+          std::min(pattern.size() - offset, size_t(segment_bytes - byte));
+      std::copy(pattern.begin() + offset, pattern.begin() + offset + length,
+                segment_.begin() + byte);
+      byte += length;
+      offset = 0;
+    }
+    for (multiple& m : multiples_) {
+      uint_fast64_t byte = m.byte;
+      uint_fast8_t index = m.index;
+      const uint_fast8_t* bits = wheel30_multiple_bit[m.residue];
+      const uint_fast8_t* carries = wheel30_multiple_carry[m.residue];
+      auto cross_off = [&]() {
+        segment_[byte] &= ~bits[index];
+        byte += m.quotient * wheel30_gaps[index] + carries[index];
+        index = (index + 1) & 7;
+      };
+      while (index != 0 && byte < segment_bytes) {
+        cross_off();
+      }
+      // whole wheel rotations, each moves by prime bytes
+      uint_fast64_t offsets[8] = { 0 };
+      for (int i = 1; i < 8; ++i) {
+        offsets[i] = offsets[i - 1] + m.quotient * wheel30_gaps[i - 1] +
+                     carries[i - 1];
+      }
+      uint_fast64_t prime = 30 * m.quotient + wheel30[m.residue];
+      for (; byte + offsets[7] < segment_bytes; byte += prime) {
+        uint_fast8_t* rotation = &segment_[byte];
+        for (int i = 0; i < 8; ++i) {
+          rotation[offsets[i]] &= ~bits[i];
+        }
+      }
+      while (byte < segment_bytes) {
+        cross_off();
+      }
+      m.byte = byte - segment_bytes;
+      m.index = index;
+    }
+    if (segment_low_ == 0) {
+      segment_[0] &= ~1;   // 1 is not a prime
+      segment_[0] |= 0x1e; // 7, 11, 13, 17 were crossed off by pattern
+    }
+    next_low_ = segment_high;
+    return true;
+  }
+
+  // calls f for each prime from current segment in range [lo, hi)
+  template <typename Function>
+  void for_each_prime(uint_fast64_t lo, uint_fast64_t hi, Function& f) const {
+    uint_fast64_t value = segment_low_;
+    for (uint_fast8_t bits : segment_) {
+      for (; bits != 0; bits &= bits - 1) {
+        uint_fast64_t prime = value + wheel30[count_trailing_zeros(bits)];
+        if (lo <= prime) {
+          if (prime >= hi) {
+            return;
+          }
+          f(prime);
+        }
+      }
+      value += 30;
+    }
+  }
+
+  // stores primes from current segment in range [lo, hi) to buffer until it's
+  // full, returns number of stored primes
+  size_t store_primes(uint_fast64_t lo, uint_fast64_t hi,
+                      uint_fast64_t* buffer, size_t size) const {
+    size_t count = 0;
+    uint_fast64_t value = segment_low_;
+    for (uint_fast8_t bits : segment_) {
+      for (; bits != 0; bits &= bits - 1) {
+        uint_fast64_t prime = value + wheel30[count_trailing_zeros(bits)];
+        if (lo <= prime) {
+          if (prime >= hi || count == size) {
+            return count;
+          }
+          buffer[count++] = prime;
+        }
+      }
+      value += 30;
+    }
+    return count;
+  }
+
+  // number of primes from current segment in range [lo, hi)
+  uint_fast64_t count_primes(uint_fast64_t lo, uint_fast64_t hi) const {
+    uint_fast64_t count = 0;
+    uint_fast64_t value = segment_low_;
+    for (uint_fast8_t bits : segment_) {
+      if (lo <= value && value + 30 <= hi) {
+        count += population_count(bits);
+      } else {
+        for (; bits != 0; bits &= bits - 1) {
+          uint_fast64_t prime = value + wheel30[count_trailing_zeros(bits)];
+          count += lo <= prime && prime < hi;
+        }
+      }
+      value += 30;
+    }
+    return count;
+  }
+
+  uint_fast64_t segment_low() const { return segment_low_; }
+
+  // bytes of current segment (whole segment, even beyond high)
+  const std::vector<uint_fast8_t>& segment() const { return segment_; }
+
+private:
+  // primes up to presieve_max are crossed off by copying pattern
+  static constexpr uint_fast32_t presieve_max = 17;
+
+  // sieve of numbers [0, 30 * 7 * 11 * 13 * 17) by primes 7, 11, 13, 17,
+  // pattern is repeating with this period
+  static const std::vector<uint_fast8_t>& presieve_pattern() {
+    static const std::vector<uint_fast8_t> pattern = []() {
+      std::vector<uint_fast8_t> bytes(7 * 11 * 13 * 17, 0);
+      for (size_t byte = 0; byte < bytes.size(); ++byte) {
+        for (uint_fast8_t bit = 0; bit < 8; ++bit) {
+          uint_fast64_t n = 30 * byte + wheel30[bit];
+          if (n % 7 != 0 && n % 11 != 0 && n % 13 != 0 && n % 17 != 0) {
+            bytes[byte] |= 1 << bit;
+          }
+        }
+      }
+      return bytes;
+    }();
+    return pattern;
+  }
+
+  struct multiple {
+    uint_fast64_t byte;     // byte of next multiple in current segment
+    uint_fast32_t quotient; // prime / 30
+    uint_fast8_t residue;   // wheel index of prime % 30
+    uint_fast8_t index;     // wheel index of multiple / prime
+  };
+
+  uint_fast64_t segment_low_;
+  uint_fast64_t next_low_;
+  uint_fast64_t high_;
+  std::vector<uint_fast8_t> segment_;
+  std::vector<multiple> multiples_;
+};
+
+inline std::vector<uint_fast32_t> sieving_primes(uint_fast64_t hi) {
+  uint_fast64_t limit = Utils::isqrt<uint_fast64_t>(hi - 1);
+  std::vector<uint_fast32_t> primes;
+  // small ranges are served from table, bigger recursively by the sieve itself
+  if (limit <= KnownPrimes::first_1000_primes.back()) {
+    for (uint_fast32_t p : KnownPrimes::first_1000_primes) {
+      if (p > limit) {
+        break;
+      }
+      if (p >= 7) {
+        primes.push_back(p);
+      }
+    }
+    return primes;
+  }
+  Generators::primes_in_range(7, limit + 1, [&primes](uint_fast64_t p) {
+    primes.push_back(static_cast<uint_fast32_t>(p));
+  });
+  return primes;
+}
+
+// products of small primes used by Tests::primorial_prime_factors
+template <typename UIntType, uint_fast32_t bound> struct primorial_table {
+  // odd primes up to bound are grouped to words (products fitting in 64b
+  // and in UIntType), words are then grouped to UIntType products
+  typedef std::numeric_limits<UIntType> limits;
+  static constexpr bool bounded = limits::is_specialized && limits::is_bounded;
+  static constexpr size_t words_per_group =
+      bounded ? limits::digits / 128 + 1 : 8;
+  static constexpr uint_fast64_t word_max =
+      bounded && limits::digits < 64
+          ? (uint_fast64_t(1) << (bounded ? limits::digits : 0)) - 1
+          : std::numeric_limits<uint_fast64_t>::max();
+
+  std::vector<uint_fast32_t> primes;
+  std::vector<uint_fast64_t> words;
+  std::vector<size_t> word_ends; // primes[word_ends[i - 1], word_ends[i]) are
+                                 // factors of words[i]
+  std::vector<UIntType> groups;
+
+  primorial_table() : primes(sieve_primes(bound)) {
+    uint_fast64_t word = 1;
+    for (size_t i = 1; i < primes.size(); ++i) {
+      if (word > word_max / primes[i]) {
+        words.push_back(word);
+        word_ends.push_back(i);
+        word = 1;
+      }
+      word *= primes[i];
+    }
+    words.push_back(word);
+    word_ends.push_back(primes.size());
+    for (size_t i = 0; i < words.size(); i += words_per_group) {
+      UIntType group = 1;
+      for (size_t j = i; j < words.size() && j < i + words_per_group; ++j) {
+        group = group * words[j];
+      }
+      groups.push_back(group);
+    }
+  }
+
+  static const primorial_table& get() {
+    static const primorial_table table;
+    return table;
+  }
+};
+
+// a / 2 over odd modulo
+template <typename UIntType>
+UIntType half_mod(const UIntType& a, const UIntType& mod) {
+  if ((a & 1) == 0) {
+    return a >> 1;
+  }
+  // (a + mod) / 2 without overflowing, both a and mod are odd
+  return (a >> 1) + (mod >> 1) + 1;
+}
+
+#if PRIMEGEN_HAS_AVX2_DISPATCH
+// whether running CPU supports AVX2, detected once
+inline bool has_avx2() {
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  return avx2;
+}
+#endif
+
+// divisibility by odd primes without division: p divides n iff
+// n * p^{-1} mod 2^w <= (2^w - 1) / p, table is padded to whole blocks by
+// entries matching only 0
+template <typename UIntType, size_t primes_count> struct inverse_table {
+  static constexpr size_t block = 16;
+  static constexpr size_t size =
+      (primes_count - 1 + block - 1) / block * block; // without 2
+
+  constexpr inverse_table() : inverse(), limit() {
+    for (size_t i = 0; i < size; ++i) {
+      if (i + 1 >= primes_count) {
+        inverse[i] = 1;
+        limit[i] = 0;
+        continue;
+      }
+      UIntType p =
+          static_cast<UIntType>(KnownPrimes::first_primes<primes_count>[i + 1]);
+      inverse[i] = p;
+      for (int j = 0; j < 5; ++j) {
+        inverse[i] *= 2 - p * inverse[i];
+      }
+      limit[i] = std::numeric_limits<UIntType>::max() / p;
+    }
+  }
+
+  UIntType inverse[size];
+  UIntType limit[size];
+};
+
+// computed at compile time
+template <typename UIntType, size_t primes_count>
+constexpr inverse_table<UIntType, primes_count> inverses{};
+
+#if PRIMEGEN_HAS_AVX2_DISPATCH
+// true if some prime of 16 entries block of inverse_table divides n, unsigned
+// a <= b is tested as min(a, b) == a
+template <typename UIntType>
+__attribute__((target("avx2"))) inline bool
+divisible_avx2(const UIntType& n, const UIntType* inverse,
+               const UIntType* limit, std::integral_constant<int, 32>) {
+  const __m256i n_lanes = _mm256_set1_epi32(static_cast<int32_t>(n));
+  __m256i divisible = _mm256_setzero_si256();
+  for (size_t i = 0; i < 16; i += 8) {
+    __m256i product = _mm256_mullo_epi32(
+        n_lanes,
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(inverse + i)));
+    __m256i bound =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(limit + i));
+    divisible = _mm256_or_si256(
+        divisible,
+        _mm256_cmpeq_epi32(_mm256_min_epu32(product, bound), product));
+  }
+  return !_mm256_testz_si256(divisible, divisible);
+}
+
+// there is no 64b multiplication in AVX2, low half of product is assembled
+// from three 32b multiplications; a <= b is tested as !(a > b)
+template <typename UIntType>
+__attribute__((target("avx2"))) inline bool
+divisible_avx2(const UIntType& n, const UIntType* inverse,
+               const UIntType* limit, std::integral_constant<int, 64>) {
+  const __m256i n_lanes = _mm256_set1_epi64x(static_cast<int64_t>(n));
+  const __m256i n_high = _mm256_srli_epi64(n_lanes, 32);
+  const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+  __m256i not_divisible = _mm256_set1_epi64x(-1);
+  for (size_t i = 0; i < 16; i += 4) {
+    __m256i factor =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(inverse + i));
+    __m256i cross = _mm256_add_epi64(
+        _mm256_mul_epu32(n_high, factor),
+        _mm256_mul_epu32(n_lanes, _mm256_srli_epi64(factor, 32)));
+    __m256i product = _mm256_add_epi64(_mm256_mul_epu32(n_lanes, factor),
+                                       _mm256_slli_epi64(cross, 32));
+    __m256i bound =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(limit + i));
+    not_divisible = _mm256_and_si256(
+        not_divisible,
+        _mm256_cmpgt_epi64(_mm256_xor_si256(product, sign),
+                           _mm256_xor_si256(bound, sign)));
+  }
+  return _mm256_movemask_epi8(not_divisible) != -1;
+}
+#endif
+
+template <typename UIntType>
+struct has_inverse_table
+    : std::integral_constant<
+          bool, std::is_integral<UIntType>::value &&
+                    std::is_unsigned<UIntType>::value &&
+                    (std::numeric_limits<UIntType>::digits == 32 ||
+                     std::numeric_limits<UIntType>::digits == 64)> {};
+
+template <size_t primes_count, typename UIntType>
+bool small_prime_factors(const UIntType& n, std::false_type) {
+  for (size_t i : KnownPrimes::first_primes<primes_count>) {
+    if (n % i == 0 && n != i) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <size_t primes_count, typename UIntType>
+bool small_prime_factors(const UIntType& n, std::true_type) {
+  typedef inverse_table<UIntType, primes_count> table_type;
+  if (n <= KnownPrimes::first_primes<primes_count>.back()) {
+    return small_prime_factors<primes_count>(n, std::false_type());
+  }
+  if ((n & 1) == 0) {
+    return false;
+  }
+  const table_type& table = inverses<UIntType, primes_count>;
+#if PRIMEGEN_HAS_AVX2_DISPATCH
+  if (has_avx2()) {
+    typedef std::integral_constant<int, std::numeric_limits<UIntType>::digits>
+        digits_type;
+    for (size_t i = 0; i < table_type::size; i += table_type::block) {
+      if (divisible_avx2(n, table.inverse + i, table.limit + i,
+                         digits_type())) {
+        return false;
+      }
+    }
+    return true;
+  }
+#endif
+  for (size_t i = 0; i < table_type::size; i += table_type::block) {
+    // no branches inside block
+    bool divisible = false;
+    for (size_t j = i; j < i + table_type::block; ++j) {
+      divisible |=
+          static_cast<UIntType>(n * table.inverse[j]) <= table.limit[j];
+    }
+    if (divisible) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// strong probable-prime tests of lanes odd numbers greater than 1 in lockstep,
+// independent multiplication chains of lanes keep multiplier busy
+template <typename UIntType, size_t lanes> struct sprp_lanes {
+  typedef typename Utils::montgomery<UIntType>::wide_type wide_type;
+  static constexpr int digits = std::numeric_limits<UIntType>::digits;
+
+  explicit sprp_lanes(const UIntType* numbers) {
+    for (size_t i = 0; i < lanes; ++i) {
+      UIntType n = numbers[i];
+      n_[i] = n;
+      inv_[i] = n;
+      for (int j = 0; j < 5; ++j) {
+        inv_[i] *= 2 - n * inv_[i];
+      }
+      one_[i] = static_cast<UIntType>(-n) % n;
+      s_[i] = count_trailing_zeros(n - 1);
+      d_[i] = (n - 1) >> s_[i];
+      max_d_ = max_d_ | d_[i];
+      max_s_ = std::max(max_s_, s_[i]);
+    }
+  }
+
+  // base in Montgomery form, by doubling (there is no R^2 mod n)
+  UIntType to_form(uint_fast32_t base, size_t i) const {
+    int top = 31;
+    while (top > 0 && ((base >> top) & 1) == 0) {
+      --top;
+    }
+    UIntType result = one_[i]; // base is never 0
+    for (int bit = top - 1; bit >= 0; --bit) {
+      result = add_mod(result, result, n_[i]);
+      if ((base >> bit) & 1) {
+        result = add_mod(result, one_[i], n_[i]);
+      }
+    }
+    return result;
+  }
+
+  UIntType mul(UIntType a, UIntType b, size_t i) const {
+    wide_type t = wide_type(a) * b;
+    UIntType m = static_cast<UIntType>(t) * inv_[i];
+    UIntType t_high = static_cast<UIntType>(t >> digits);
+    UIntType mn_high = static_cast<UIntType>((wide_type(m) * n_[i]) >> digits);
+    UIntType result = t_high - mn_high;
+    return t_high < mn_high ? result + n_[i] : result;
+  }
+
+  // clears pass[i] if i-th number is not strong probable prime to base, base
+  // divisible by number says nothing
+  void test(uint_fast32_t base, bool* pass) const {
+    UIntType a[lanes];
+    UIntType x[lanes];
+    bool ok[lanes];
+    for (size_t i = 0; i < lanes; ++i) {
+      a[i] = to_form(base, i);
+      x[i] = one_[i];
+    }
+    // left-to-right, lanes with shorter d just square 1 at the beginning
+    int bits = 0;
+    for (UIntType d = max_d_; d != 0; d >>= 1) {
+      ++bits;
+    }
+    for (int bit = bits - 1; bit >= 0; --bit) {
+      for (size_t i = 0; i < lanes; ++i) {
+        x[i] = mul(x[i], x[i], i);
+        UIntType y = mul(x[i], a[i], i);
+        x[i] = (d_[i] >> bit) & 1 ? y : x[i];
+      }
+    }
+    for (size_t i = 0; i < lanes; ++i) {
+      ok[i] = a[i] == 0 || x[i] == one_[i] || x[i] == n_[i] - one_[i];
+    }
+    for (int r = 1; r < max_s_; ++r) {
+      for (size_t i = 0; i < lanes; ++i) {
+        x[i] = mul(x[i], x[i], i);
+        ok[i] = ok[i] || (r < s_[i] && x[i] == n_[i] - one_[i]);
+      }
+    }
+    for (size_t i = 0; i < lanes; ++i) {
+      pass[i] = pass[i] && ok[i];
+    }
+  }
+
+  UIntType n_[lanes];
+  UIntType inv_[lanes]; // n^{-1} mod R
+  UIntType one_[lanes]; // R mod n
+  UIntType d_[lanes];   // n - 1 = d * 2^s
+  int s_[lanes];
+  UIntType max_d_ = 0; // bitwise or of all d
+  int max_s_ = 0;
+};
+
+template <typename UIntType, size_t lanes> struct sprp_lanes_test {
+  void operator()(const sprp_lanes<UIntType, lanes>& numbers,
+                  uint_fast32_t base, bool* pass) const {
+    numbers.test(base, pass);
+  }
+};
+
+#if PRIMEGEN_HAS_AVX2_DISPATCH
+// Montgomery multiplication of 8 32b lanes, even and odd lanes are multiplied
+// separately to 64b products
+__attribute__((target("avx2"))) inline __m256i
+mul_avx2(__m256i a, __m256i b, __m256i n, __m256i inv) {
+  const __m256i sign = _mm256_set1_epi32(INT32_MIN);
+  __m256i t_even = _mm256_mul_epu32(a, b);
+  __m256i t_odd =
+      _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+  __m256i n_odd = _mm256_srli_epi64(n, 32);
+  __m256i mn_even = _mm256_mul_epu32(_mm256_mul_epu32(t_even, inv), n);
+  __m256i mn_odd = _mm256_mul_epu32(
+      _mm256_mul_epu32(t_odd, _mm256_srli_epi64(inv, 32)), n_odd);
+  // high halves of products back in 32b lanes
+  __m256i t_high = _mm256_blend_epi32(_mm256_srli_epi64(t_even, 32), t_odd,
+                                      0xaa);
+  __m256i mn_high = _mm256_blend_epi32(_mm256_srli_epi64(mn_even, 32), mn_odd,
+                                       0xaa);
+  __m256i result = _mm256_sub_epi32(t_high, mn_high);
+  __m256i borrow = _mm256_cmpgt_epi32(_mm256_xor_si256(mn_high, sign),
+                                      _mm256_xor_si256(t_high, sign));
+  return _mm256_add_epi32(result, _mm256_and_si256(borrow, n));
+}
+
+// same as sprp_lanes<uint32_t, 8>::test in AVX2 registers
+__attribute__((target("avx2"))) inline void
+sprp_test_avx2(const sprp_lanes<uint32_t, 8>& numbers, uint_fast32_t base,
+               bool* pass) {
+  alignas(32) uint32_t a_lanes[8];
+  for (size_t i = 0; i < 8; ++i) {
+    a_lanes[i] = numbers.to_form(base, i);
+  }
+  const __m256i a = _mm256_load_si256(reinterpret_cast<__m256i*>(a_lanes));
+  const __m256i n =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(numbers.n_));
+  const __m256i inv =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(numbers.inv_));
+  const __m256i one =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(numbers.one_));
+  const __m256i d =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(numbers.d_));
+  const __m256i s =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(numbers.s_));
+  const __m256i minus_one = _mm256_sub_epi32(n, one);
+  const __m256i bit_mask = _mm256_set1_epi32(1);
+
+  int bits = 0;
+  for (uint32_t rest = numbers.max_d_; rest != 0; rest >>= 1) {
+    ++bits;
+  }
+  __m256i x = one;
+  for (int bit = bits - 1; bit >= 0; --bit) {
+    x = mul_avx2(x, x, n, inv);
+    __m256i y = mul_avx2(x, a, n, inv);
+    __m256i selected = _mm256_cmpeq_epi32(
+        _mm256_and_si256(_mm256_srli_epi32(d, bit), bit_mask), bit_mask);
+    x = _mm256_blendv_epi8(x, y, selected);
+  }
+  __m256i ok = _mm256_or_si256(
+      _mm256_cmpeq_epi32(a, _mm256_setzero_si256()),
+      _mm256_or_si256(_mm256_cmpeq_epi32(x, one),
+                      _mm256_cmpeq_epi32(x, minus_one)));
+  for (int r = 1; r < numbers.max_s_; ++r) {
+    x = mul_avx2(x, x, n, inv);
+    __m256i squaring = _mm256_cmpgt_epi32(s, _mm256_set1_epi32(r));
+    ok = _mm256_or_si256(
+        ok, _mm256_and_si256(squaring, _mm256_cmpeq_epi32(x, minus_one)));
+  }
+  int ok_bits = _mm256_movemask_ps(_mm256_castsi256_ps(ok));
+  for (size_t i = 0; i < 8; ++i) {
+    pass[i] = pass[i] && ((ok_bits >> i) & 1);
+  }
+}
+
+struct sprp_lanes_test_avx2 {
+  void operator()(const sprp_lanes<uint32_t, 8>& numbers, uint_fast32_t base,
+                  bool* pass) const {
+    sprp_test_avx2(numbers, base, pass);
+  }
+};
+#endif
+
+// miller_rabin_batch with lanes tested by Test, numbers are collected to
+// groups of lanes, survivors of base 2 are regrouped for remaining bases
+template <typename UIntType, size_t lanes, typename Test>
+void miller_rabin_batch(const UIntType* numbers, size_t count, bool* results,
+                        Test test) {
+  static constexpr uint_fast32_t witnesses_32[] = { 7, 61 };
+  static constexpr uint_fast32_t witnesses_64[] = { 325,     9375,   28178,
+                                                    450775,  9780504,
+                                                    1795265022 };
+  struct group {
+    size_t index[lanes];
+    size_t size;
+  };
+  group base_2 = {}, small = {}, big = {};
+
+  // unused lanes of incomplete group repeat first number
+  auto run = [&](group& g, const uint_fast32_t* begin,
+                 const uint_fast32_t* end) {
+    UIntType lane_numbers[lanes];
+    bool pass[lanes];
+    for (size_t i = 0; i < lanes; ++i) {
+      lane_numbers[i] = numbers[g.index[i < g.size ? i : 0]];
+      pass[i] = true;
+    }
+    sprp_lanes<UIntType, lanes> tested(lane_numbers);
+    for (const uint_fast32_t* base = begin; base != end; ++base) {
+      test(tested, *base, pass);
+    }
+    for (size_t i = 0; i < g.size; ++i) {
+      results[g.index[i]] = pass[i];
+    }
+  };
+  auto run_survivors = [&]() {
+    for (size_t i = 0; i < base_2.size; ++i) {
+      size_t index = base_2.index[i];
+      if (!results[index]) {
+        continue;
+      }
+      group& g =
+          numbers[index] < static_cast<uint_fast64_t>(4759123141) ? small : big;
+      g.index[g.size++] = index;
+      if (g.size == lanes) {
+        if (&g == &small) {
+          run(g, std::begin(witnesses_32), std::end(witnesses_32));
+        } else {
+          run(g, std::begin(witnesses_64), std::end(witnesses_64));
+        }
+        g.size = 0;
+      }
+    }
+    base_2.size = 0;
+  };
+  static constexpr uint_fast32_t witness_2[] = { 2 };
+
+  for (size_t i = 0; i < count; ++i) {
+    UIntType n = numbers[i];
+    if (n < 4 || (n & 1) == 0) {
+      results[i] = n == 2 || n == 3;
+      continue;
+    }
+    base_2.index[base_2.size++] = i;
+    if (base_2.size == lanes) {
+      run(base_2, std::begin(witness_2), std::end(witness_2));
+      run_survivors();
+    }
+  }
+  if (base_2.size != 0) {
+    run(base_2, std::begin(witness_2), std::end(witness_2));
+    run_survivors();
+  }
+  if (small.size != 0) {
+    run(small, std::begin(witnesses_32), std::end(witnesses_32));
+  }
+  if (big.size != 0) {
+    run(big, std::begin(witnesses_64), std::end(witnesses_64));
+  }
+}
+
+template <typename UIntType>
+void miller_rabin_batch(const UIntType* numbers, size_t count, bool* results,
+                        std::integral_constant<int, 64>) {
+  miller_rabin_batch<UIntType, 8>(numbers, count, results,
+                                  sprp_lanes_test<UIntType, 8>());
+}
+
+template <typename UIntType>
+void miller_rabin_batch(const UIntType* numbers, size_t count, bool* results,
+                        std::integral_constant<int, 32>) {
+#if PRIMEGEN_HAS_AVX2_DISPATCH
+  if (std::is_same<UIntType, uint32_t>::value && has_avx2()) {
+    miller_rabin_batch<uint32_t, 8>(
+        reinterpret_cast<const uint32_t*>(numbers), count, results,
+        sprp_lanes_test_avx2());
+    return;
+  }
+#endif
+  miller_rabin_batch<UIntType, 8>(numbers, count, results,
+                                  sprp_lanes_test<UIntType, 8>());
+}
+}
+
+namespace Generators {
+template <typename UIntType, size_t w, typename RandomNumberEngine,
+          bool (&PrimarityTest)(const UIntType&), size_t sieve_primes,
+          typename Stats>
+inline auto random_prime_engine<UIntType, w, RandomNumberEngine,
+                                PrimarityTest, sieve_primes, Stats>::
+operator()() -> result_type {
+  uint_fast64_t start = Stats::now();
+  UIntType prime_candidate =
+      Utils::independent_bits_generator<UIntType, RandomNumberEngine, w>(e_);
+  prime_candidate = prime_candidate | 1; // we need odd number
+  prime_candidate =
+      prime_candidate | (UIntType(1) << (w - 1)); // we want big primes
+  const UIntType first = prime_candidate;
+  // residues modulo small primes are computed once per generated prime and
+  // then only advanced by word-size additions
+  Utils::candidate_sieve<UIntType, 4096, sieve_primes> candidates(
+      prime_candidate);
+  uint_fast64_t test_cycles = 0;
+  while (true) {
+    prime_candidate = candidates.next();
+    if (Details::timed_test<Stats, UIntType, PrimarityTest>(prime_candidate,
+                                                            test_cycles)) {
+      Details::record_search<Stats>(first, prime_candidate,
+                                    Stats::now() - start - test_cycles);
+      return prime_candidate;
+    }
+  }
+}
+
+template <typename UIntType, size_t w, typename RandomNumberEngine,
+          bool (&PrimarityTest)(const UIntType&), size_t sieve_primes>
+auto safe_prime_engine<UIntType, w, RandomNumberEngine, PrimarityTest,
+                       sieve_primes>::operator()() -> result_type {
+  const UIntType two = 2;
+  while (true) {
+    // q has w - 1 bits, so p = 2q + 1 has w bits
+    UIntType q =
+        Utils::independent_bits_generator<UIntType, RandomNumberEngine, w - 1>(
+            e_);
+    q = q | 1;
+    q = q | (UIntType(1) << (w - 2));
+    Utils::safe_candidate_sieve<UIntType, 4096, sieve_primes> candidates(q);
+    while ((q = candidates.next()) >> (w - 2) == 1) {
+      if (!Utils::strong_probable_prime<UIntType>(q)(two)) {
+        continue;
+      }
+      UIntType p = (q << 1) + 1;
+      if (Utils::pow_mod(two, UIntType(p - 1), p) == 1 && PrimarityTest(q)) {
+        return p;
+      }
+    }
+  }
+}
+
+template <typename UIntType, size_t w, typename RandomNumberEngine,
+          bool (&PrimarityTest)(const UIntType&),
+          uint_fast32_t public_exponent, size_t sieve_primes>
+template <typename... Args>
+rsa_prime_engine<UIntType, w, RandomNumberEngine, PrimarityTest,
+                 public_exponent,
+                 sieve_primes>::rsa_prime_engine(Args&&... args)
+    : e_(std::forward<Args>(args)...) {
+  for (uint_fast64_t r : Factor::factorize<uint_fast64_t>(public_exponent)) {
+    if (exponent_factors_.empty() || exponent_factors_.back() != r) {
+      exponent_factors_.push_back(static_cast<uint_fast32_t>(r));
+    }
+  }
+}
+
+template <typename UIntType, size_t w, typename RandomNumberEngine,
+          bool (&PrimarityTest)(const UIntType&),
+          uint_fast32_t public_exponent, size_t sieve_primes>
+auto rsa_prime_engine<UIntType, w, RandomNumberEngine, PrimarityTest,
+                      public_exponent, sieve_primes>::operator()()
+    -> result_type {
+  while (true) {
+    UIntType candidate =
+        Utils::independent_bits_generator<UIntType, RandomNumberEngine, w>(e_);
+    candidate = candidate | 1;
+    candidate = candidate | (UIntType(3) << (w - 2)); // two highest bits
+    Utils::candidate_sieve<UIntType, 4096, sieve_primes> candidates(
+        candidate);
+    // gcd(p - 1, e) = 1 iff p is not 1 modulo any prime factor of e
+    for (uint_fast32_t r : exponent_factors_) {
+      candidates.exclude(r, 1);
+    }
+    // candidate has w bits (2^w is not built, w may be width of UIntType and
+    // such candidate wraps around to small number)
+    while ((candidate = candidates.next()) >> (w - 1) == 1) {
+      if (PrimarityTest(candidate)) {
+        return candidate;
+      }
+    }
+  }
+}
+
+template <typename PrimeEngine>
+std::vector<typename PrimeEngine::result_type>
+random_primes(size_t count, uint_fast64_t seed, unsigned threads) {
+  typedef typename std::decay<decltype(
+      std::declval<PrimeEngine>().base())>::type base_type;
+  std::vector<typename PrimeEngine::result_type> primes(count);
+  std::atomic<size_t> next_index(0);
+  Details::run_parallel(Details::thread_count(threads), [&](unsigned) {
+    for (size_t i = next_index++; i < count; i = next_index++) {
+      primes[i] = Details::generate_seeded<PrimeEngine>(
+          seed, i, std::is_constructible<base_type, std::seed_seq&>());
+    }
+  });
+  return primes;
+}
+
+template <typename UIntType, size_t accuracy> UIntType next_prime(UIntType n) {
+  return next_prime<UIntType, Tests::miller_rabin<UIntType, accuracy> >(n);
+}
+
+template <typename UIntType, bool (&PrimarityTest)(const UIntType&),
+          size_t sieve_primes, typename Stats>
+UIntType next_prime(UIntType n) {
+  uint_fast64_t start = Stats::now();
+  const UIntType first = (n + 1) | 1;
+  Utils::candidate_sieve<UIntType, 4096, sieve_primes> candidates(first);
+  uint_fast64_t test_cycles = 0;
+  while (true) {
+    n = candidates.next();
+    if (Details::timed_test<Stats, UIntType, PrimarityTest>(n, test_cycles)) {
+      Details::record_search<Stats>(first, n,
+                                    Stats::now() - start - test_cycles);
+      return n;
+    }
+  }
+}
+
+template <typename UIntType, bool (&PrimarityTest)(const UIntType&)>
+UIntType parallel_next_prime(UIntType n, unsigned threads) {
+  constexpr uint_fast32_t window = 128;
+  typedef Utils::candidate_sieve<UIntType, window> sieve_type;
+  const sieve_type origin((n + 1) | 1);
+  // lowest window with a prime found so far
+  std::atomic<uint_fast64_t> found_window(
+      std::numeric_limits<uint_fast64_t>::max());
+  std::atomic<uint_fast64_t> next_window(0);
+  threads = Details::thread_count(threads);
+  std::vector<std::pair<uint_fast64_t, UIntType> > results(
+      threads,
+      std::make_pair(std::numeric_limits<uint_fast64_t>::max(), UIntType(0)));
+
+  Details::run_parallel(threads, [&](unsigned t) {
+    sieve_type candidates(origin);
+    uint_fast64_t current = 0;
+    for (uint_fast64_t w = next_window++; w < found_window; w = next_window++) {
+      if (w != current) {
+        candidates.skip(w - current);
+        current = w;
+      }
+      UIntType candidate;
+      // window is abandoned when prime is found in a lower one
+      while (w < found_window && candidates.next_in_window(candidate)) {
+        if (PrimarityTest(candidate)) {
+          results[t] = std::make_pair(w, candidate);
+          uint_fast64_t lowest = found_window;
+          while (w < lowest && !found_window.compare_exchange_weak(lowest, w)) {
+          }
+          break;
+        }
+      }
+    }
+  });
+  // every window below found_window was fully tested without finding a prime
+  return std::min_element(results.begin(), results.end(),
+                          [](const std::pair<uint_fast64_t, UIntType>& a,
+                             const std::pair<uint_fast64_t, UIntType>& b) {
+                            return a.first < b.first;
+                          })->second;
+}
+
+template <typename UIntType, uint_fast32_t accuracy>
+UIntType parallel_next_prime(UIntType n, unsigned threads) {
+  return parallel_next_prime<UIntType,
+                             Tests::miller_rabin<UIntType, accuracy> >(
+      n, threads);
+}
+
+template <typename Function>
+void primes_in_range(uint_fast64_t lo, uint_fast64_t hi, Function f) {
+  // 2, 3, 5 are not represented in wheel
+  for (uint_fast64_t p : { 2, 3, 5 }) {
+    if (lo <= p && p < hi) {
+      f(p);
+    }
+  }
+  if (hi <= 7) {
+    return;
+  }
+  Details::wheel_sieve sieve(lo, hi, Details::sieving_primes(hi));
+  while (sieve.next_segment()) {
+    sieve.for_each_prime(lo, hi, f);
+  }
+}
+
+inline size_t primes_in_range(uint_fast64_t lo, uint_fast64_t hi,
+                              uint_fast64_t* buffer, size_t size) {
+  size_t count = 0;
+  for (uint_fast64_t p : { 2, 3, 5 }) {
+    if (lo <= p && p < hi && count < size) {
+      buffer[count++] = p;
+    }
+  }
+  if (hi <= 7) {
+    return count;
+  }
+  // sieved range is estimated from average gap between primes, so small
+  // buffers don't need sieving primes up to sqrt(hi), it's doubled when the
+  // estimate is short
+  double estimate = 2 * (std::log(double(lo) + 2) + 1) * double(size) +
+                    30 * Details::wheel_sieve::segment_bytes;
+  uint_fast64_t span =
+      estimate < double(hi - lo) ? uint_fast64_t(estimate) : hi - lo;
+  while (lo < hi && count < size) {
+    uint_fast64_t end = hi - lo > span ? lo + span : hi;
+    Details::wheel_sieve sieve(lo, end, Details::sieving_primes(end));
+    while (count < size && sieve.next_segment()) {
+      count += sieve.store_primes(lo, end, buffer + count, size - count);
+    }
+    lo = end;
+    span = std::min(2 * span, hi);
+  }
+  return count;
+}
+
+template <typename Function>
+void parallel_primes_in_range(uint_fast64_t lo, uint_fast64_t hi, Function f,
+                              unsigned threads) {
+  threads = Details::thread_count(threads);
+  for (uint_fast64_t p : { 2, 3, 5 }) {
+    if (lo <= p && p < hi) {
+      f(p);
+    }
+  }
+  if (hi <= 7) {
+    return;
+  }
+  lo = std::max<uint_fast64_t>(lo, 7);
+  const std::vector<uint_fast32_t> sieving_primes = Details::sieving_primes(hi);
+  constexpr uint_fast64_t block = Details::wheel_sieve::parallel_block;
+  uint_fast64_t blocks = (hi - lo + block - 1) / block;
+  std::atomic<uint_fast64_t> next_block(0);
+  // reorder window, block b is stored in slot b % slots and workers don't
+  // start block before its slot is emitted
+  const uint_fast64_t slots = 2 * threads;
+  std::vector<std::vector<uint_fast64_t> > buffers(slots);
+  std::vector<bool> ready(slots, false);
+  uint_fast64_t emitted = 0; // number of blocks already emitted
+  std::mutex mutex;
+  std::condition_variable changed;
+  // calling thread emits blocks in order while workers sieve following ones
+  Details::run_parallel(threads + 1, [&](unsigned t) {
+    if (t == 0) {
+      std::vector<uint_fast64_t> buffer;
+      for (uint_fast64_t b = 0; b < blocks; ++b) {
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          changed.wait(lock, [&] { return bool(ready[b % slots]); });
+          buffer.swap(buffers[b % slots]);
+          ready[b % slots] = false;
+          emitted = b + 1;
+        }
+        changed.notify_all();
+        for (uint_fast64_t p : buffer) {
+          f(p);
+        }
+      }
+      return;
+    }
+    std::vector<uint_fast64_t> buffer;
+    auto store = [&buffer](uint_fast64_t p) { buffer.push_back(p); };
+    for (uint_fast64_t b = next_block++; b < blocks; b = next_block++) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] { return b < emitted + slots; });
+      }
+      uint_fast64_t block_lo = lo + b * block;
+      uint_fast64_t block_hi = hi - block_lo > block ? block_lo + block : hi;
+      buffer.clear();
+      Details::wheel_sieve sieve(block_lo, block_hi, sieving_primes);
+      while (sieve.next_segment()) {
+        sieve.for_each_prime(block_lo, block_hi, store);
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        buffer.swap(buffers[b % slots]);
+        ready[b % slots] = true;
+      }
+      changed.notify_all();
+    }
+  });
+}
+
+inline uint_fast64_t count_primes_in_range(uint_fast64_t lo, uint_fast64_t hi,
+                                           unsigned threads) {
+  threads = Details::thread_count(threads);
+  uint_fast64_t count = 0;
+  for (uint_fast64_t p : { 2, 3, 5 }) {
+    count += lo <= p && p < hi;
+  }
+  if (hi <= 7) {
+    return count;
+  }
+  lo = std::max<uint_fast64_t>(lo, 7);
+  const std::vector<uint_fast32_t> sieving_primes = Details::sieving_primes(hi);
+  constexpr uint_fast64_t block = Details::wheel_sieve::parallel_block;
+  uint_fast64_t blocks = (hi - lo + block - 1) / block;
+  std::atomic<uint_fast64_t> next_block(0);
+  std::vector<uint_fast64_t> counts(threads, 0);
+  Details::run_parallel(threads, [&](unsigned t) {
+    uint_fast64_t local_count = 0;
+    for (uint_fast64_t b = next_block++; b < blocks; b = next_block++) {
+      uint_fast64_t block_lo = lo + b * block;
+      uint_fast64_t block_hi = hi - block_lo > block ? block_lo + block : hi;
+      Details::wheel_sieve sieve(block_lo, block_hi, sieving_primes);
+      while (sieve.next_segment()) {
+        local_count += sieve.count_primes(block_lo, block_hi);
+      }
+    }
+    counts[t] = local_count;
+  });
+  for (uint_fast64_t c : counts) {
+    count += c;
+  }
+  return count;
+}
+}
+
+namespace Tests {
+template <typename UIntType, size_t accuracy>
+bool miller_rabin(const UIntType& n) {
+  return miller_rabin<UIntType, accuracy>(n, Details::witness_engine());
+}
+
+template <typename UIntType, size_t accuracy, typename RandomNumberEngine>
+bool miller_rabin(const UIntType& n, RandomNumberEngine& engine) {
+  if ((n & 1) == 0) {
+    return false;
+  }
+  Utils::strong_probable_prime<UIntType> is_sprp(n);
+  const UIntType lo = 2;
+  const UIntType hi = n - 2;
+  for (size_t i = 0; i < accuracy; ++i) {
+    UIntType witness =
+        Details::uniform_random(lo, hi, engine, std::is_integral<UIntType>());
+    if (!is_sprp(witness)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename UIntType, size_t w>
+bool miller_rabin_deterministic(const UIntType& n) {
+  // w is 0 for unbounded types like mpz_class
+  if (w != 0 && w <= 64) {
+    return miller_rabin_deterministic_64(n);
+  }
+  if ((n & 1) == 0) {
+    return false;
+  }
+
+  UIntType witness;
+  Utils::strong_probable_prime<UIntType> is_sprp(n);
+
+  // check for all generators of (Z/nZ)* (witness for n must be one of them)
+  // according to GRH, generators must be in [2, min(n-1, floor(2* (ln n)^2))]
+  double n_log = Utils::log<UIntType, w>(n);
+  UIntType upper_bound = static_cast<UIntType>(2 * n_log * n_log);
+  upper_bound = (n - 1) < upper_bound ? n - 1 : upper_bound;
+
+  for (witness = 2; witness <= upper_bound; ++witness) {
+    if (!is_sprp(witness)) {
       return false;
     }
   }
-  return true;
+  return true;
+}
+
+template <typename UIntType>
+bool miller_rabin_deterministic_64(const UIntType& n) {
+  static constexpr uint_fast32_t witnesses_32[] = { 2, 7, 61 };
+  static constexpr uint_fast32_t witnesses_64[] = { 2,      325,     9375,
+                                                    28178,  450775,  9780504,
+                                                    1795265022 };
+  if ((n & 1) == 0) {
+    return false;
+  }
+
+  Utils::strong_probable_prime<UIntType> is_sprp(n);
+  auto test_witnesses = [&](const uint_fast32_t* begin,
+                            const uint_fast32_t* end) {
+    for (const uint_fast32_t* i = begin; i != end; ++i) {
+      // witnesses may be greater than n, witness divisible by n says nothing
+      UIntType witness = UIntType(*i) % n;
+      if (witness != 0 && !is_sprp(witness)) {
+        return false;
+      }
+    }
+    return true;
+  };
+  if (n < static_cast<uint_fast64_t>(4759123141)) {
+    return test_witnesses(std::begin(witnesses_32), std::end(witnesses_32));
+  }
+  return test_witnesses(std::begin(witnesses_64), std::end(witnesses_64));
+}
+
+template <typename UIntType>
+void miller_rabin_batch(const UIntType* numbers, size_t count, bool* results) {
+  static_assert(Utils::is_native_uint<UIntType>::value,
+                "miller_rabin_batch requires 32b or 64b built-in type");
+  Details::miller_rabin_batch(
+      numbers, count, results,
+      std::integral_constant<int, std::numeric_limits<UIntType>::digits>());
+}
+
+template <typename UIntType> bool strong_lucas(const UIntType& n) {
+  if ((n & 1) == 0) {
+    return false;
+  }
+
+  // Selfridge's method A: first D in 5, -7, 9, -11, ... with (D / n) = -1
+  uint_fast32_t d_abs = 5;
+  bool d_negative = false;
+  UIntType d_mod; // D mod n
+  for (uint_fast32_t tries = 0;; ++tries) {
+    UIntType d_abs_mod = UIntType(d_abs) % n;
+    d_mod = (d_negative && d_abs_mod != 0) ? n - d_abs_mod : d_abs_mod;
+    int j = Utils::jacobi(d_mod, n);
+    if (j == -1) {
+      break;
+    }
+    if (j == 0 && n != d_abs) {
+      return false; // D shares a factor with n
+    }
+    // Jacobi symbol never gets -1 for squares
+    if (tries == 10) {
+      UIntType root = Utils::isqrt(n);
+      if (root * root == n) {
+        return false;
+      }
+    }
+    d_abs += 2;
+    d_negative = !d_negative;
+  }
+  // P = 1, Q = (1 - D) / 4
+  uint_fast32_t q_abs = d_negative ? (d_abs + 1) / 4 : (d_abs - 1) / 4;
+  UIntType q = UIntType(q_abs) % n;
+  if (!d_negative && q != 0) {
+    q = n - q;
+  }
+
+  // n + 1 = 2^first * second, n + 1 can't overflow since n = max is divisible
+  // by 3 or 5 for all built-in types
+  std::pair<UIntType, UIntType> factors =
+      Utils::fac_2_powers<UIntType>(n + 1);
+  UIntType mask = 1;
+  while (mask <= (factors.second >> 1)) {
+    mask = mask << 1;
+  }
+
+  // U_1, V_1, Q^1 for highest bit, then doubling and incrementing index
+  UIntType u = 1;
+  UIntType v = 1;
+  UIntType q_k = q;
+  while ((mask = mask >> 1) != 0) {
+    u = Utils::mul_mod(u, v, n);
+    v = Details::sub_mod(Utils::mul_mod(v, v, n),
+                         Details::add_mod(q_k, q_k, n), n);
+    q_k = Utils::mul_mod(q_k, q_k, n);
+    if ((factors.second & mask) != 0) {
+      // U_{k+1} = (P U_k + V_k) / 2, V_{k+1} = (D U_k + P V_k) / 2
+      UIntType u_next = Details::half_mod(Details::add_mod(u, v, n), n);
+      v = Details::half_mod(
+          Details::add_mod(Utils::mul_mod(d_mod, u, n), v, n), n);
+      u = u_next;
+      q_k = Utils::mul_mod(q_k, q, n);
+    }
+  }
+
+  if (u == 0 || v == 0) {
+    return true;
+  }
+  for (UIntType r = 1; r < factors.first; ++r) {
+    v = Details::sub_mod(Utils::mul_mod(v, v, n),
+                         Details::add_mod(q_k, q_k, n), n);
+    if (v == 0) {
+      return true;
+    }
+    q_k = Utils::mul_mod(q_k, q_k, n);
+  }
+  return false;
+}
+
+template <typename UIntType> bool baillie_psw(const UIntType& n) {
+  if ((n & 1) == 0) {
+    return false;
+  }
+  return Utils::strong_probable_prime<UIntType>(n)(2) && strong_lucas(n);
+}
+
+template <typename UIntType> bool f100_prime_factors(const UIntType& n) {
+  return first_prime_factors<UIntType, 100>(n);
+}
+
+template <typename UIntType, uint_fast32_t bound>
+bool primorial_prime_factors(const UIntType& n) {
+  typedef Details::primorial_table<UIntType, bound> table_type;
+  const table_type& table = table_type::get();
+  if (n < bound + 1) {
+    uint_fast64_t small_n = Details::to_uint_fast64(n);
+    return small_n == 1 || std::binary_search(table.primes.begin(),
+                                              table.primes.end(), small_n);
+  }
+  if ((n & 1) == 0) {
+    return false;
+  }
+  size_t word = 0;
+  size_t prime = 1; // 2 is already checked
+  for (const UIntType& group : table.groups) {
+    UIntType rest = n % group;
+    size_t group_end = std::min(word + table_type::words_per_group,
+                                table.words.size());
+    for (; word < group_end; ++word) {
+      // gcd(rest, words[word]) != 1 iff one of its prime factors divides
+      // rest, checking the factors one by one is cheaper than Euclid
+      uint_fast64_t word_rest =
+          Details::to_uint_fast64<UIntType>(rest % table.words[word]);
+      for (; prime < table.word_ends[word]; ++prime) {
+        if (word_rest % table.primes[prime] == 0) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+template <typename UIntType, size_t count>
+bool first_prime_factors(const UIntType& n) {
+  return Details::small_prime_factors<count>(
+      n, Details::has_inverse_table<UIntType>());
+}
+
+template <typename UIntType> bool f1000_prime_factors(const UIntType& n) {
+  return first_prime_factors<UIntType, 1000>(n);
+}
+}
+
+namespace Utils {
+template <typename UIntType>
+size_t number_traits<UIntType>::bit_length(const UIntType& n) {
+  return Details::bit_length(n, Details::is_builtin_64<UIntType>());
+}
+
+template <typename UIntType>
+size_t number_traits<UIntType>::trailing_zeros(const UIntType& n) {
+  return Details::trailing_zeros(n, Details::is_builtin_64<UIntType>());
+}
+
+template <typename UIntType>
+uint_fast64_t number_traits<UIntType>::low_64(const UIntType& n) {
+  return Details::low_64<UIntType>(n, Details::conversion_rank());
+}
+
+template <typename UIntType>
+uint_fast64_t number_traits<UIntType>::high_64(const UIntType& n) {
+  size_t bits = bit_length(n);
+  if (bits <= 64) {
+    return low_64(n);
+  }
+  return low_64(n >> (bits - 64));
+}
+
+template <typename UIntType>
+UIntType number_traits<UIntType>::mul_mod(const UIntType& a,
+                                          const UIntType& b,
+                                          const UIntType& mod) {
+  return Details::mul_mod(a, b, mod, is_native_uint<UIntType>());
+}
+
+template <typename UIntType>
+UIntType number_traits<UIntType>::pow_mod(UIntType base, UIntType exp,
+                                          const UIntType& mod) {
+  return Details::pow_mod(base, exp, mod, is_native_uint<UIntType>());
+}
+
+/// @cond
+// limbs of UInt are accessed directly
+template <size_t Bits> struct number_traits<UInt<Bits> > {
+  static size_t bit_length(const UInt<Bits>& n) { return n.bit_length(); }
+
+  static size_t trailing_zeros(const UInt<Bits>& n) {
+    size_t i = 0;
+    while (n.limb(i) == 0) {
+      ++i;
+    }
+    return i * Details::limb_digits + Details::count_trailing_zeros(n.limb(i));
+  }
+
+  static uint_fast64_t low_64(const UInt<Bits>& n) {
+    uint_fast64_t low = 0;
+    for (size_t i = 0; i < UInt<Bits>::limbs && i * Details::limb_digits < 64;
+         ++i) {
+      low |= static_cast<uint_fast64_t>(n.limb(i))
+             << (i * Details::limb_digits);
+    }
+    return low;
+  }
+
+  static uint_fast64_t high_64(const UInt<Bits>& n) {
+    size_t bits = n.bit_length();
+    return low_64(bits <= 64 ? n : n >> (bits - 64));
+  }
+
+  static UInt<Bits> mul_mod(const UInt<Bits>& a, const UInt<Bits>& b,
+                            const UInt<Bits>& mod) {
+    return a * b % mod;
+  }
+
+  static UInt<Bits> pow_mod(const UInt<Bits>& base, const UInt<Bits>& exp,
+                            const UInt<Bits>& mod) {
+    return Details::pow_mod(base, exp, mod, std::false_type());
+  }
+};
+/// @endcond
+
+template <typename UIntType>
+std::pair<UIntType, UIntType> fac_2_powers(const UIntType& n) {
+  size_t powers = number_traits<UIntType>::trailing_zeros(n);
+  return std::pair<UIntType, UIntType>(UIntType(powers), n >> powers);
+}
+
+template <typename UIntType>
+UIntType pow_mod(UIntType base, UIntType exp, const UIntType& mod) {
+  return number_traits<UIntType>::pow_mod(base, exp, mod);
+}
+
+template <typename UIntType>
+UIntType mul_mod(const UIntType& a, const UIntType& b, const UIntType& mod) {
+  return number_traits<UIntType>::mul_mod(a, b, mod);
+}
+
+template <typename UIntType> int jacobi(UIntType a, UIntType n) {
+  int result = 1;
+  a = a % n;
+  while (a != 0) {
+    while ((a & 1) == 0) {
+      a = a >> 1;
+      UIntType n_mod_8 = n & 7;
+      if (n_mod_8 == 3 || n_mod_8 == 5) {
+        result = -result;
+      }
+    }
+    std::swap(a, n);
+    if ((a & 3) == 3 && (n & 3) == 3) {
+      result = -result;
+    }
+    a = a % n;
+  }
+  return n == 1 ? result : 0;
+}
+
+template <typename UIntType> UIntType isqrt(const UIntType& n) {
+  UIntType rest = n;
+  UIntType result = 0;
+  // highest power of 4 not greater than n
+  UIntType bit = 1;
+  while (bit <= (n >> 2)) {
+    bit = bit << 2;
+  }
+  while (bit != 0) {
+    if (rest >= result + bit) {
+      rest = rest - (result + bit);
+      result = (result >> 1) + bit;
+    } else {
+      result = result >> 1;
+    }
+    bit = bit >> 2;
+  }
+  return result;
+}
+
+template <typename UIntType>
+montgomery<UIntType>::montgomery(const UIntType& mod)
+    : mod_(mod) {
+  // Newton's iteration, each step doubles number of correct low bits (n * n
+  // == 1 mod 8 for odd n, so we start with 3 correct bits)
+  mod_inv_ = mod_;
+  for (int i = 0; i < 5; ++i) {
+    mod_inv_ *= 2 - mod_ * mod_inv_;
+  }
+  one_ = static_cast<word_type>(-mod_) % mod_;
+  r2_ = static_cast<word_type>(wide_type(one_) * one_ % mod_);
+}
+
+template <typename UIntType>
+inline auto montgomery<UIntType>::reduce(wide_type t) const -> word_type {
+  constexpr int word_digits = std::numeric_limits<word_type>::digits;
+  // low half of m * mod equals low half of t, so (t - m * mod) / R is just
+  // difference of high halves
+  word_type m = static_cast<word_type>(t) * mod_inv_;
+  word_type t_high = static_cast<word_type>(t >> word_digits);
+  word_type mn_high =
+      static_cast<word_type>((wide_type(m) * mod_) >> word_digits);
+  word_type result = t_high - mn_high;
+  return t_high < mn_high ? result + mod_ : result;
+}
+
+template <typename UIntType>
+inline auto montgomery<UIntType>::to_form(const UIntType& a) const
+    -> word_type {
+  return mul(static_cast<word_type>(a % mod_), r2_);
+}
+
+template <typename UIntType>
+inline UIntType montgomery<UIntType>::from_form(word_type a) const {
+  return static_cast<UIntType>(reduce(a));
+}
+
+template <typename UIntType>
+auto montgomery<UIntType>::pow(word_type base, UIntType exp) const
+    -> word_type {
+  word_type result = one_;
+  while (exp > 0) {
+    if ((exp & 1) == 1) // if odd
+    {
+      result = mul(result, base);
+    }
+    base = mul(base, base);
+    exp = exp >> 1;
+  }
+  return result;
+}
+
+template <typename UIntType, bool native>
+strong_probable_prime<UIntType, native>::strong_probable_prime(
+    const UIntType& n)
+    : n_(n), n_minus_1_(n - 1), factors_(fac_2_powers<UIntType>(n - 1)) {}
+
+template <typename UIntType, bool native>
+bool strong_probable_prime<UIntType, native>::
+operator()(const UIntType& witness) const {
+  UIntType x = pow_mod(witness, factors_.second, n_);
+  if (x == 1 || x == n_minus_1_) {
+    return true;
+  }
+  for (UIntType j = 1; j < factors_.first; ++j) {
+    x = mul_mod(x, x, n_);
+    if (x == 1 || x == n_minus_1_) {
+      break;
+    }
+  }
+  return x == n_minus_1_;
+}
+
+template <typename UIntType>
+strong_probable_prime<UIntType, true>::strong_probable_prime(
+    const UIntType& n)
+    : mont_(n), minus_one_(mont_.mod() - mont_.one()),
+      factors_(fac_2_powers<UIntType>(n - 1)) {}
+
+template <typename UIntType>
+bool strong_probable_prime<UIntType, true>::
+operator()(const UIntType& witness) const {
+  // all comparisons are done in Montgomery form, 1 and n - 1 have unique
+  // representations there
+  word_type x = mont_.pow(mont_.to_form(witness), factors_.second);
+  if (x == mont_.one() || x == minus_one_) {
+    return true;
+  }
+  for (UIntType j = 1; j < factors_.first; ++j) {
+    x = mont_.mul(x, x);
+    if (x == mont_.one() || x == minus_one_) {
+      break;
+    }
+  }
+  return x == minus_one_;
 }
+
+template <typename UIntType, uint_fast32_t window, size_t primes_count>
+candidate_sieve<UIntType, window, primes_count>::candidate_sieve(
+    const UIntType& start)
+    : base_(start), small_base_(0), position_(0) {
+  const primes_type& primes = KnownPrimes::first_primes<primes_count>;
+  if (start < primes.back() + 1) {
+    small_base_ =
+        static_cast<uint_fast32_t>(Details::to_uint_fast64(start));
+  }
+  // the only place where UIntType is divided
+  for (size_t i = 1; i < primes.size(); ++i) {
+    residues_[i] = static_cast<uint_fast32_t>(
+        Details::to_uint_fast64<UIntType>(start % primes[i]));
+  }
+  sieve();
 }
 
-namespace Utils {
-template <typename UIntType>
-std::pair<UIntType, UIntType> fac_2_powers(const UIntType& n) {
-  std::pair<UIntType, UIntType> factored(0, n);
-  while ((factored.second & 1) == 0) // if even
-  {
-    factored.second = factored.second >> 1;
-    ++factored.first;
+template <typename UIntType, uint_fast32_t window, size_t primes_count>
+void candidate_sieve<UIntType, window, primes_count>::sieve() {
+  const primes_type& primes = KnownPrimes::first_primes<primes_count>;
+  composite_.fill(false);
+  // 2 is skipped, all candidates are odd
+  for (size_t i = 1; i < primes.size(); ++i) {
+    // 64 bits, product of two residues overflows 32 bits for large primes
+    uint_fast64_t p = primes[i];
+    // first index j with base_ + 2j divisible by p, ie. 2j == -residue mod p
+    uint_fast64_t j = (p - residues_[i]) % p * ((p + 1) / 2) % p;
+    if (small_base_ != 0 && small_base_ + 2 * j == p) {
+      j += p; // p itself is prime
+    }
+    for (; j < window; j += p) {
+      composite_[j] = true;
+    }
+  }
+  for (const exclusion& e : exclusions_) {
+    uint_fast64_t m = e.modulus;
+    uint_fast64_t j =
+        (e.residue + m - e.base_residue) % m * ((m + 1) / 2) % m;
+    for (; j < window; j += m) {
+      composite_[j] = true;
+    }
   }
-  return factored;
 }
 
-template <typename UIntType>
-UIntType pow_mod(UIntType base, UIntType exp, const UIntType& mod) {
-  UIntType result = 1;
-  while (exp > 0) {
-    if ((exp & 1) == 1) // if odd
-    {
-      result = (result * base) % mod;
+template <typename UIntType, uint_fast32_t window, size_t primes_count>
+void candidate_sieve<UIntType, window, primes_count>::exclude(
+    uint_fast32_t modulus, uint_fast32_t residue) {
+  exclusions_.push_back(
+      { modulus, residue,
+        Details::to_uint_fast64<UIntType>(base_ % modulus) });
+  sieve();
+}
+
+template <typename UIntType, uint_fast32_t window, size_t primes_count>
+bool candidate_sieve<UIntType, window, primes_count>::next_in_window(
+    UIntType& candidate) {
+  for (; position_ < window; ++position_) {
+    if (!composite_[position_]) {
+      candidate = base_ + 2 * position_++;
+      return true;
     }
-    base = (base * base) % mod;
-    exp = exp >> 1;
   }
-  return result;
+  return false;
+}
+
+template <typename UIntType, uint_fast32_t window, size_t primes_count>
+UIntType candidate_sieve<UIntType, window, primes_count>::next() {
+  UIntType candidate;
+  while (!next_in_window(candidate)) {
+    skip(1);
+  }
+  return candidate;
+}
+
+template <typename UIntType, uint_fast32_t window, size_t primes_count>
+void candidate_sieve<UIntType, window, primes_count>::skip(
+    uint_fast64_t windows) {
+  const primes_type& primes = KnownPrimes::first_primes<primes_count>;
+  uint_fast64_t distance = 2 * window * windows;
+  base_ = base_ + distance;
+  for (size_t i = 1; i < primes.size(); ++i) {
+    residues_[i] = (residues_[i] + distance % primes[i]) % primes[i];
+  }
+  for (exclusion& e : exclusions_) {
+    e.base_residue = (e.base_residue + distance % e.modulus) % e.modulus;
+  }
+  // window may still contain sieving primes when it's smaller than them
+  small_base_ = base_ < primes.back() + 1 ? static_cast<uint_fast32_t>(
+                                                 Details::to_uint_fast64(base_))
+                                           : 0;
+  position_ = 0;
+  sieve();
+}
+
+template <typename UIntType, uint_fast32_t window, size_t primes_count>
+safe_candidate_sieve<UIntType, window, primes_count>::safe_candidate_sieve(
+    const UIntType& start)
+    : base_(start), position_(0) {
+  const primes_type& primes = KnownPrimes::first_primes<primes_count>;
+  for (size_t i = 1; i < primes.size(); ++i) {
+    residues_[i] = static_cast<uint_fast32_t>(
+        Details::to_uint_fast64<UIntType>(start % primes[i]));
+  }
+  sieve();
+}
+
+template <typename UIntType, uint_fast32_t window, size_t primes_count>
+void safe_candidate_sieve<UIntType, window, primes_count>::sieve() {
+  const primes_type& primes = KnownPrimes::first_primes<primes_count>;
+  composite_.fill(false);
+  for (size_t i = 1; i < primes.size(); ++i) {
+    uint_fast64_t p = primes[i]; // 64 bits, see candidate_sieve::sieve
+    uint_fast64_t half = (p + 1) / 2; // 2^{-1} mod p
+    // first indices j with p dividing base_ + 2j and 2 (base_ + 2j) + 1
+    uint_fast64_t j = (p - residues_[i]) % p * half % p;
+    uint_fast64_t k = (p - 1 + (p - residues_[i]) % p * 2) % p * half % p *
+                      half % p;
+    for (; j < window; j += p) {
+      composite_[j] = true;
+    }
+    for (; k < window; k += p) {
+      composite_[k] = true;
+    }
+  }
+}
+
+template <typename UIntType, uint_fast32_t window, size_t primes_count>
+UIntType safe_candidate_sieve<UIntType, window, primes_count>::next() {
+  const primes_type& primes = KnownPrimes::first_primes<primes_count>;
+  while (true) {
+    for (; position_ < window; ++position_) {
+      if (!composite_[position_]) {
+        return base_ + 2 * position_++;
+      }
+    }
+    constexpr uint_fast64_t distance = 2 * window;
+    base_ = base_ + distance;
+    for (size_t i = 1; i < primes.size(); ++i) {
+      residues_[i] = (residues_[i] + distance % primes[i]) % primes[i];
+    }
+    position_ = 0;
+    sieve();
+  }
 }
 
 template <typename UIntType, size_t w> double log(const UIntType& n) {
   constexpr size_t w_64 = std::numeric_limits<uint_fast64_t>::digits;
-  constexpr size_t w_rest = w < w_64 ? 0 : (w - w_64);
   const static double log_2 = std::log(2);
 
-  double result;
-  double log_b;
-  uint_fast64_t high_order;
-  UIntType high_order_big;
-  std::stringstream ss;
-
-  // compute logarithm only from highest order that fit in 64b integer, rest is
+  // compute logarithm only from highest 64 significant bits, rest is
   // truncated as effectively zero
-  high_order_big = (n >> w_rest);
-
-  // it's sure high_order not fits to uint_64t
-  // streams are slow, but most generic conversion
-  ss << high_order_big;
-  ss >> high_order;
-
-  log_b = std::log(high_order);
-  result = log_b + w_rest * log_2;
+  size_t bits = number_traits<UIntType>::bit_length(n);
+  size_t w_rest = bits < w_64 ? 0 : (bits - w_64);
+  uint_fast64_t high_order = number_traits<UIntType>::high_64(n);
 
-  return result;
+  return std::log(high_order) + w_rest * log_2;
 }
 
 template <typename UIntType, typename EngineType, size_t w>
@@ -501,6 +3587,851 @@ UIntType independent_bits_generator(EngineType& _32b_generator) {
   }
   return return_val;
 }
+
+inline uint_fast64_t thread_stats::now() {
+#if PRIMEGEN_HAS_AVX2_DISPATCH
+  // x86 with GCC compatible intrinsics
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+inline void thread_stats::record_test(bool accepted, uint_fast64_t cycles) {
+  Details::thread_counters& counters = Details::thread_counters::local();
+  counters.add(Details::stats_tests, 1);
+  counters.add(accepted ? Details::stats_accepting_test_cycles
+                        : Details::stats_rejecting_test_cycles,
+               cycles);
+}
+
+inline void thread_stats::record_search(uint_fast64_t candidates,
+                                        uint_fast64_t sieve_cycles) {
+  Details::thread_counters& counters = Details::thread_counters::local();
+  counters.add(Details::stats_searches, 1);
+  counters.add(Details::stats_candidates, candidates);
+  counters.add(Details::stats_sieve_cycles, sieve_cycles);
+}
+
+inline search_stats thread_stats::local() {
+  return Details::to_search_stats(Details::thread_counters::local().get());
+}
+
+inline search_stats thread_stats::total() {
+  return Details::to_search_stats(Details::thread_counters::total());
+}
+}
+
+namespace Details {
+// integer cube root
+inline uint_fast64_t icbrt(uint_fast64_t n) {
+  uint_fast64_t root = static_cast<uint_fast64_t>(std::cbrt(double(n)));
+  // fix rounding errors of floating point root
+  while (root * root * root > n) {
+    --root;
+  }
+  while ((root + 1) * (root + 1) * (root + 1) <= n) {
+    ++root;
+  }
+  return root;
+}
+
+// tables of numbers up to y used by prime counting, primes are indexed from 1
+// (primes[0] is 0)
+struct counting_tables {
+  explicit counting_tables(uint_fast32_t y)
+      : primes(1, 0), pi(y + 1, 0), factor(y + 1, 0) {
+    std::vector<uint32_t> lpf(y + 1, 0);
+    // least prime factor of 1 is greater than any prime
+    factor[1] = std::numeric_limits<int32_t>::max();
+    for (uint_fast32_t n = 2; n <= y; ++n) {
+      if (lpf[n] == 0) {
+        primes.push_back(n);
+        for (uint_fast32_t m = n; m <= y; m += n) {
+          if (lpf[m] == 0) {
+            lpf[m] = n;
+          }
+        }
+      }
+      uint_fast32_t rest = n / lpf[n];
+      int32_t p = static_cast<int32_t>(lpf[n]);
+      if (rest == 1 || (lpf[rest] != lpf[n] && factor[rest] != 0)) {
+        factor[n] = factor[rest] < 0 ? p : -p;
+      }
+      pi[n] = static_cast<uint32_t>(primes.size() - 1);
+    }
+  }
+
+  std::vector<uint32_t> primes;
+  std::vector<uint32_t> pi;
+  // least prime factor with sign of Moebius function, 0 for numbers which
+  // are not square-free
+  std::vector<int32_t> factor;
+};
+
+// phi(n, 6) ie. count of numbers in [1, n] not divisible by primes up to 13,
+// numbers coprime to primorial are counted in one period
+class phi_tiny {
+public:
+  static constexpr size_t primes_count = 6;
+
+  phi_tiny() : counts_(primorial) {
+    uint32_t count = 0;
+    for (uint_fast32_t r = 0; r < primorial; ++r) {
+      count += coprime(r);
+      counts_[r] = count;
+    }
+  }
+
+  uint_fast64_t operator()(uint_fast64_t n) const {
+    return n / primorial * totient + counts_[n % primorial];
+  }
+
+  static bool coprime(uint_fast64_t n) {
+    return n % 2 != 0 && n % 3 != 0 && n % 5 != 0 && n % 7 != 0 &&
+           n % 11 != 0 && n % 13 != 0;
+  }
+
+  static constexpr uint_fast32_t primorial = 2 * 3 * 5 * 7 * 11 * 13;
+  static constexpr uint_fast32_t totient = 1 * 2 * 4 * 6 * 10 * 12;
+
+private:
+  std::vector<uint32_t> counts_; // counts_[r] = phi(r, 6)
+};
+
+// sieve of odd numbers of segment [low, high) for special leaves, keeps count
+// of numbers which were not crossed off and counts them up to increasing bound
+// (numbers not crossed off are counted also for each 8 words, so counting
+// doesn't need to scan whole segment)
+class leaf_sieve {
+public:
+  // size must be multiple of 1024
+  explicit leaf_sieve(uint_fast64_t size)
+      : words_(size / 128), counters_(size / 1024) {}
+
+  // odd numbers of [low, high) without prime factors up to 13 are not crossed
+  // off, low must be multiple of 128
+  void reset(uint_fast64_t low, uint_fast64_t high) {
+    // bit i of word w in pattern is number 2 (64 w + i) + 1, pattern has
+    // period 3 * 5 * 7 * 11 * 13 words
+    static const std::vector<uint64_t> pattern = []() {
+      std::vector<uint64_t> words(phi_tiny::primorial / 2);
+      for (uint_fast64_t i = 0; i < 64 * words.size(); ++i) {
+        if (phi_tiny::coprime(2 * i + 1)) {
+          words[i / 64] |= uint64_t(1) << (i % 64);
+        }
+      }
+      return words;
+    }();
+    low_ = low;
+    bits_ = (high - low) / 2;
+    uint_fast64_t offset = (low / 128) % pattern.size();
+    for (uint_fast64_t& word : words_) {
+      word = pattern[offset];
+      offset = offset + 1 == pattern.size() ? 0 : offset + 1;
+    }
+    for (uint_fast64_t i = bits_; i < 64 * words_.size(); i += 64 - i % 64) {
+      words_[i / 64] &= ~(~uint64_t(0) << (i % 64));
+    }
+    total_ = 0;
+    for (size_t i = 0; i < counters_.size(); ++i) {
+      counters_[i] = 0;
+      for (size_t word = 8 * i; word < 8 * i + 8; ++word) {
+        counters_[i] += population_count(words_[word]);
+      }
+      total_ += counters_[i];
+    }
+    restart_count();
+  }
+
+  // crosses off odd multiples of prime from multiple (odd multiple not lower
+  // than low), multiple is moved to next segment
+  void cross_off(uint_fast64_t prime, uint_fast64_t& multiple) {
+    uint_fast64_t i = (multiple - low_) / 2;
+    for (; i < bits_; i += prime) {
+      uint64_t& word = words_[i / 64];
+      uint_fast32_t bit = (word >> (i % 64)) & 1;
+      total_ -= bit;
+      counters_[i / 512] -= bit;
+      word &= ~(uint64_t(1) << (i % 64));
+    }
+    multiple = low_ + 2 * i + 1;
+  }
+
+  // numbers not crossed off in [low, n], n must not decrease until next
+  // restart_count()
+  uint_fast64_t count_to(uint_fast64_t n) {
+    if (n <= low_) {
+      return 0;
+    }
+    uint_fast64_t i = (n - low_ - 1) / 2;
+    for (; counted_ < i / 512; ++counted_) {
+      count_ += counters_[counted_];
+    }
+    uint_fast64_t count = count_;
+    for (uint_fast64_t word = counted_ * 8; word < i / 64; ++word) {
+      count += population_count(words_[word]);
+    }
+    return count + population_count(words_[i / 64] &
+                                    (~uint64_t(0) >> (63 - i % 64)));
+  }
+
+  void restart_count() {
+    counted_ = 0;
+    count_ = 0;
+  }
+
+  // numbers not crossed off in whole segment
+  uint_fast64_t count() const { return total_; }
+
+private:
+  std::vector<uint64_t> words_;
+  std::vector<uint32_t> counters_; // numbers not crossed off in 8 words
+  uint_fast64_t low_;
+  uint_fast64_t bits_;
+  uint_fast64_t total_;
+  uint_fast64_t counted_; // counters summed to count_
+  uint_fast64_t count_;
+};
+
+// contribution of one block of segments to special leaves, phi values are
+// relative to block start
+struct leaves_block {
+  int_fast64_t sum;
+  std::vector<int_fast64_t> phi;   // phi[b] numbers left after p_{b-1}
+  std::vector<int_fast64_t> signs; // sum of signs of leaves for each b
+};
+
+// special leaves phi(x / (p_b m), b - 1) counted by sieving numbers up to
+// limit, leaves with prime m, p_b^2 > y and value not greater than y (and
+// lower than p_b^2) are left for leaves_easy
+inline void leaves_hard_block(uint_fast64_t x, uint_fast64_t y,
+                              const counting_tables& t, uint_fast64_t low,
+                              uint_fast64_t high, uint_fast64_t segment_size,
+                              leaves_block& block) {
+  constexpr size_t c = phi_tiny::primes_count;
+  const std::vector<uint32_t>& primes = t.primes;
+  size_t a = t.pi[y];
+  block.sum = 0;
+  block.phi.assign(a, 0);
+  block.signs.assign(a, 0);
+  std::vector<uint_fast64_t> multiples(a);
+  for (size_t b = c + 1; b < a; ++b) {
+    uint_fast64_t p = primes[b];
+    uint_fast64_t multiple = (low + p - 1) / p * p;
+    multiples[b] = multiple % 2 == 0 ? multiple + p : multiple;
+  }
+  leaf_sieve sieve(segment_size);
+  for (; low < high; low += segment_size) {
+    uint_fast64_t segment_high = std::min(low + segment_size, high);
+    // primes up to p_c are crossed off by reset
+    sieve.reset(low, segment_high);
+    for (size_t b = c + 1; b < a; ++b) {
+      uint_fast64_t p = primes[b];
+      uint_fast64_t x_p = x / p;
+      // leaves with values in [low, segment_high)
+      uint_fast64_t max_m = std::min(x_p / std::max<uint_fast64_t>(low, 1), y);
+      uint_fast64_t min_m = std::max(x_p / segment_high, y / p);
+      int_fast64_t phi = block.phi[b];
+      sieve.restart_count();
+      if (p * p <= y) {
+        if (p >= max_m) {
+          // no leaves for this and all next primes in next segments
+          break;
+        }
+        for (uint_fast64_t m = max_m; m > min_m; --m) {
+          int_fast32_t factor = t.factor[m];
+          if (factor > int_fast32_t(p) || -factor > int_fast32_t(p)) {
+            // leaf has sign -mu(m)
+            int_fast64_t value = phi + sieve.count_to(x_p / m);
+            block.sum += factor < 0 ? value : -value;
+            block.signs[b] += factor < 0 ? 1 : -1;
+          }
+        }
+      } else {
+        // only prime m, leaves with value greater than y or p^2 are hard
+        uint_fast64_t max_hard =
+            std::min(max_m, std::max(x_p / (y + 1), x_p / (p * p)));
+        if (p >= max_hard) {
+          // no hard leaves for this and all next primes in next segments
+          break;
+        }
+        uint_fast64_t min_hard = std::max(min_m, p);
+        for (size_t l = t.pi[max_hard]; max_hard > min_hard &&
+                                        l > t.pi[min_hard];
+             --l) {
+          block.sum += phi + sieve.count_to(x_p / primes[l]);
+          ++block.signs[b];
+        }
+      }
+      block.phi[b] += sieve.count();
+      sieve.cross_off(p, multiples[b]);
+    }
+  }
+}
+
+// special leaves with prime m > p_b > sqrt(y) and value not greater than y
+// and lower than p_b^2, which are counted by lookup to pi table
+inline int_fast64_t leaves_easy(uint_fast64_t x, uint_fast64_t y, size_t b,
+                                const counting_tables& t) {
+  const std::vector<uint32_t>& primes = t.primes;
+  const std::vector<uint32_t>& pi = t.pi;
+  size_t a = pi[y];
+  uint_fast64_t p = primes[b];
+  uint_fast64_t x_p = x / p;
+  // leaves with prime q in (min_q, y] are not hard, they have value lower
+  // than p for q > x_p / p
+  uint_fast64_t min_q =
+      std::max(p, std::min(std::max(x_p / (y + 1), x_p / (p * p)), y));
+  uint_fast64_t min_trivial_q = std::max(min_q, std::min(x_p / p, y));
+  int_fast64_t sum = pi[y] - pi[min_trivial_q];
+  // all q from (x_p / next prime after value, q] give the same pi(value)
+  size_t l = pi[min_trivial_q];
+  size_t min_l = pi[min_q];
+  while (l > min_l) {
+    uint_fast64_t value = x_p / primes[l];
+    int_fast64_t phi = int_fast64_t(pi[value]) - int_fast64_t(b) + 2;
+    size_t next = pi[value] + 1;
+    size_t cluster_l = next <= a ? pi[x_p / primes[next]] : min_l;
+    cluster_l = std::max(cluster_l, min_l);
+    sum += phi * int_fast64_t(l - cluster_l);
+    l = cluster_l;
+  }
+  return sum;
+}
+
+// P2(x, a) = number of n <= x with exactly two prime factors greater than y
+inline uint_fast64_t partial_p2(uint_fast64_t x, uint_fast64_t y,
+                                unsigned threads) {
+  uint_fast64_t sqrt_x = Utils::isqrt<uint_fast64_t>(x);
+  if (y >= sqrt_x) {
+    return 0;
+  }
+  // values x / p for primes p in (y, sqrt_x] are in [sqrt_x, x / y]
+  uint_fast64_t lo = sqrt_x;
+  uint_fast64_t hi = x / y + 1;
+  const std::vector<uint_fast32_t> primes = sieving_primes(hi);
+  constexpr uint_fast64_t block = wheel_sieve::parallel_block;
+  uint_fast64_t blocks = (hi - lo + block - 1) / block;
+  // per block: primes in block, sum of pi(x / p) - pi(block start - 1) for p
+  // with x / p in block and number of such p
+  std::vector<std::array<uint_fast64_t, 3> > results(blocks);
+  std::atomic<uint_fast64_t> next_block(0);
+  run_parallel(threads, [&](unsigned) {
+    std::vector<uint_fast64_t> ps;
+    std::vector<uint_fast64_t> segment_primes;
+    for (uint_fast64_t k = next_block++; k < blocks; k = next_block++) {
+      uint_fast64_t block_lo = lo + k * block;
+      uint_fast64_t block_hi = std::min(block_lo + block, hi);
+      ps.clear();
+      Generators::primes_in_range(
+          std::max(y, x / block_hi) + 1, std::min(sqrt_x, x / block_lo) + 1,
+          [&](uint_fast64_t p) { ps.push_back(p); });
+      std::array<uint_fast64_t, 3>& result = results[k];
+      result = { { 0, 0, ps.size() } };
+      // x / p increases with decreasing p
+      auto p = ps.rbegin();
+      wheel_sieve sieve(block_lo, block_hi, primes);
+      while (sieve.next_segment()) {
+        segment_primes.clear();
+        auto push = [&](uint_fast64_t prime) {
+          segment_primes.push_back(prime);
+        };
+        sieve.for_each_prime(block_lo, block_hi, push);
+        uint_fast64_t segment_hi =
+            sieve.segment_low() + 30 * wheel_sieve::segment_bytes;
+        for (; p != ps.rend() && x / *p < segment_hi; ++p) {
+          result[1] += result[0] +
+                       (std::upper_bound(segment_primes.begin(),
+                                         segment_primes.end(), x / *p) -
+                        segment_primes.begin());
+        }
+        result[0] += segment_primes.size();
+      }
+    }
+  });
+  uint_fast64_t a = Generators::count_primes_in_range(0, y + 1, 1);
+  uint_fast64_t pi_sqrt_x = Generators::count_primes_in_range(0, lo + 1, 1);
+  uint_fast64_t pi_before = Generators::count_primes_in_range(0, lo, 1);
+  // sum of pi(x / p) - pi(p) + 1, where sum of pi(p) - 1 is arithmetic series
+  uint_fast64_t sum = 0;
+  for (const std::array<uint_fast64_t, 3>& result : results) {
+    sum += result[1] + result[2] * pi_before;
+    pi_before += result[0];
+  }
+  return sum - (pi_sqrt_x * (pi_sqrt_x - 1) - a * (a - 1)) / 2;
+}
+}
+
+namespace Counting {
+inline uint_fast64_t prime_pi(uint_fast64_t x, unsigned threads) {
+  threads = Details::thread_count(threads);
+  if (x < 100000000) {
+    return Generators::count_primes_in_range(0, x + 1, threads);
+  }
+  // y = alpha * cbrt(x), bigger alpha moves work from sieving to pi table
+  double alpha = std::max(1.0, std::pow(std::log(double(x)), 3) / 7000);
+  uint_fast64_t y = std::min<uint_fast64_t>(
+      uint_fast64_t(alpha * Details::icbrt(x)), Utils::isqrt(x));
+  Details::counting_tables t(static_cast<uint_fast32_t>(y));
+  size_t a = t.pi[y];
+  constexpr size_t c = Details::phi_tiny::primes_count;
+  size_t sqrt_y_b = std::max<size_t>(c, t.pi[Utils::isqrt(y)]);
+
+  // phi(x, a) = ordinary leaves + special leaves, ordinary leaves are
+  // mu(n) phi(x / n, c) for n without prime factors up to p_c
+  Details::phi_tiny phi_c;
+  int_fast64_t phi = 0;
+  for (uint_fast64_t n = 1; n <= y; ++n) {
+    int_fast32_t factor = t.factor[n];
+    if (factor > int_fast32_t(t.primes[c]) ||
+        -factor > int_fast32_t(t.primes[c])) {
+      int_fast64_t leaf = phi_c(x / n);
+      phi += factor > 0 ? leaf : -leaf;
+    }
+  }
+
+  std::atomic<size_t> next_b(sqrt_y_b + 1);
+  std::vector<int_fast64_t> easy(threads, 0);
+  Details::run_parallel(threads, [&](unsigned thread) {
+    for (size_t b = next_b++; b < a; b = next_b++) {
+      easy[thread] += Details::leaves_easy(x, y, b, t);
+    }
+  });
+  for (int_fast64_t sum : easy) {
+    phi += sum;
+  }
+
+  // hard leaves, blocks of segments are counted concurrently with phi values
+  // relative to block start and combined in order
+  uint_fast64_t limit = (x / y + 2) & ~uint_fast64_t(1);
+  uint_fast64_t segment_size = 1 << 16;
+  while (segment_size * segment_size < limit) {
+    segment_size *= 2;
+  }
+  uint_fast64_t segments = (limit + segment_size - 1) / segment_size;
+  uint_fast64_t blocks = threads == 1 ? 1 : std::min<uint_fast64_t>(
+                                                segments, 8 * threads);
+  uint_fast64_t block_segments = (segments + blocks - 1) / blocks;
+  blocks = (segments + block_segments - 1) / block_segments;
+  std::vector<Details::leaves_block> results(blocks);
+  std::atomic<uint_fast64_t> next_block(0);
+  Details::run_parallel(threads, [&](unsigned) {
+    for (uint_fast64_t k = next_block++; k < blocks; k = next_block++) {
+      uint_fast64_t low = k * block_segments * segment_size;
+      uint_fast64_t high =
+          std::min(low + block_segments * segment_size, limit);
+      Details::leaves_hard_block(x, y, t, low, high, segment_size,
+                                 results[k]);
+    }
+  });
+  std::vector<int_fast64_t> phi_before(a, 0);
+  for (const Details::leaves_block& result : results) {
+    phi += result.sum;
+    for (size_t b = c + 1; b < a; ++b) {
+      phi += result.signs[b] * phi_before[b];
+      phi_before[b] += result.phi[b];
+    }
+  }
+
+  return uint_fast64_t(phi) + a - 1 - Details::partial_p2(x, y, threads);
+}
+}
+
+namespace Details {
+// logarithmic integral by Ramanujan's series, x must be greater than 1
+inline double li(double x) {
+  constexpr double euler_gamma = 0.5772156649015329;
+  double log_x = std::log(x);
+  double sum = 0;
+  double term = 1;       // (-1)^(n-1) log^n x / (n! 2^(n-1))
+  double inner_sum = 0;  // sum of 1 / (2k + 1) for k <= (n - 1) / 2
+  for (int n = 1; n < 200; ++n) {
+    term *= (n == 1 ? 1 : -0.5) * log_x / n;
+    if (n % 2 == 1) {
+      inner_sum += 1.0 / n;
+    }
+    double last = sum;
+    sum += term * inner_sum;
+    if (sum == last) {
+      break;
+    }
+  }
+  return euler_gamma + std::log(log_x) + std::sqrt(x) * sum;
+}
+
+// x with R(x) = n, R(x) is approximated by li(x) - li(x^1/2) / 2 -
+// li(x^1/3) / 3 and inverted by Newton's method, n must be greater than 100
+inline uint_fast64_t nth_prime_estimate(uint_fast64_t n) {
+  double target = double(n);
+  double x = target * std::log(target);
+  for (int i = 0; i < 100; ++i) {
+    double r = li(x) - li(std::sqrt(x)) / 2 - li(std::cbrt(x)) / 3;
+    double step = (r - target) * std::log(x);
+    x -= step;
+    if (std::abs(step) < 1) {
+      break;
+    }
+  }
+  return uint_fast64_t(x);
+}
+
+// k-th prime (counted from 1) in [lo, hi), range must contain at least k
+// primes
+inline uint_fast64_t kth_prime_in_range(uint_fast64_t lo, uint_fast64_t hi,
+                                        uint_fast64_t k) {
+  uint_fast64_t result = 0;
+  Generators::primes_in_range(lo, hi, [&](uint_fast64_t p) {
+    if (k != 0 && --k == 0) {
+      result = p;
+    }
+  });
+  return result;
+}
+}
+
+namespace Generators {
+inline uint_fast64_t nth_prime(uint_fast64_t n, unsigned threads) {
+  threads = Details::thread_count(threads);
+  // primes up to x are counted exactly, then windows are walked up or down
+  uint_fast64_t x = 0;
+  uint_fast64_t count = 0;
+  if (n > 100000) {
+    x = Details::nth_prime_estimate(n);
+    count = Counting::prime_pi(x, threads);
+  }
+  uint_fast64_t window = std::max<uint_fast64_t>(
+      Details::wheel_sieve::parallel_block, Utils::isqrt(x));
+  if (count < n) {
+    // (n - count)-th prime greater than x
+    uint_fast64_t k = n - count;
+    for (uint_fast64_t lo = x + 1;; lo += window) {
+      uint_fast64_t found = count_primes_in_range(lo, lo + window, threads);
+      if (found >= k) {
+        return Details::kth_prime_in_range(lo, lo + window, k);
+      }
+      k -= found;
+    }
+  }
+  // (count - n + 1)-th prime not greater than x counted downwards
+  uint_fast64_t k = count - n + 1;
+  for (uint_fast64_t hi = x + 1;; hi -= window) {
+    uint_fast64_t lo = hi > window ? hi - window : 0;
+    uint_fast64_t found = count_primes_in_range(lo, hi, threads);
+    if (found >= k) {
+      return Details::kth_prime_in_range(lo, hi, found - k + 1);
+    }
+    k -= found;
+  }
+}
+}
+
+namespace Details {
+template <typename UIntType> UIntType gcd(UIntType a, UIntType b) {
+  while (b != 0) {
+    UIntType rest = a % b;
+    a = b;
+    b = rest;
+  }
+  return a;
+}
+
+// arithmetic modulo factorized number n, numbers are held in internal form
+// (Montgomery form for built-in types), which has the same gcd with n as the
+// number itself
+template <typename UIntType, bool = Utils::is_native_uint<UIntType>::value>
+class factor_modulus {
+public:
+  typedef UIntType value_type;
+
+  explicit factor_modulus(const UIntType& n) : n_(n) {}
+
+  value_type to_form(const UIntType& a) const { return a % n_; }
+  UIntType from_form(const value_type& a) const { return a; }
+  value_type one() const { return 1; }
+  value_type mul(const value_type& a, const value_type& b) const {
+    return Utils::mul_mod(a, b, n_);
+  }
+  value_type pow(const value_type& a, const UIntType& exp) const {
+    return Utils::pow_mod(a, exp, n_);
+  }
+  value_type add(const value_type& a, const value_type& b) const {
+    return add_mod(a, b, n_);
+  }
+  value_type sub(const value_type& a, const value_type& b) const {
+    return sub_mod(a, b, n_);
+  }
+
+private:
+  UIntType n_;
+};
+
+template <typename UIntType> class factor_modulus<UIntType, true> {
+public:
+  typedef typename Utils::montgomery<UIntType>::word_type value_type;
+
+  explicit factor_modulus(const UIntType& n) : mont_(n) {}
+
+  value_type to_form(const UIntType& a) const { return mont_.to_form(a); }
+  UIntType from_form(value_type a) const { return mont_.from_form(a); }
+  value_type one() const { return mont_.one(); }
+  value_type mul(value_type a, value_type b) const { return mont_.mul(a, b); }
+  value_type pow(value_type a, const UIntType& exp) const {
+    return mont_.pow(a, exp);
+  }
+  value_type add(value_type a, value_type b) const {
+    return add_mod(a, b, mont_.mod());
+  }
+  value_type sub(value_type a, value_type b) const {
+    return sub_mod(a, b, mont_.mod());
+  }
+
+private:
+  Utils::montgomery<UIntType> mont_;
+};
+
+#if PRIMEGEN_HAS_UINT128
+// Montgomery arithmetic over odd 128b modulo (R = 2^128) as in
+// Utils::montgomery, double-width products are composed of four 64b products
+template <> class factor_modulus<unsigned __int128, false> {
+public:
+  typedef unsigned __int128 value_type;
+
+  explicit factor_modulus(const value_type& n) : n_(n) {
+    n_inv_ = n;
+    for (int i = 0; i < 6; ++i) {
+      n_inv_ *= 2 - n * n_inv_;
+    }
+    one_ = (0 - n) % n;
+    // R^2 mod n by doubling R mod n
+    r2_ = one_;
+    for (int i = 0; i < 128; ++i) {
+      r2_ = add(r2_, r2_);
+    }
+  }
+
+  value_type to_form(const value_type& a) const { return mul(a % n_, r2_); }
+  value_type from_form(value_type a) const { return reduce(0, a); }
+  value_type one() const { return one_; }
+  value_type mul(value_type a, value_type b) const {
+    value_type high, low;
+    multiply(a, b, high, low);
+    return reduce(high, low);
+  }
+  value_type pow(value_type base, value_type exp) const {
+    value_type result = one_;
+    while (exp > 0) {
+      if ((exp & 1) == 1) {
+        result = mul(result, base);
+      }
+      base = mul(base, base);
+      exp = exp >> 1;
+    }
+    return result;
+  }
+  value_type add(value_type a, value_type b) const {
+    return add_mod(a, b, n_);
+  }
+  value_type sub(value_type a, value_type b) const {
+    return sub_mod(a, b, n_);
+  }
+
+private:
+  static void multiply(value_type a, value_type b, value_type& high,
+                       value_type& low) {
+    uint64_t a0 = static_cast<uint64_t>(a);
+    uint64_t a1 = static_cast<uint64_t>(a >> 64);
+    uint64_t b0 = static_cast<uint64_t>(b);
+    uint64_t b1 = static_cast<uint64_t>(b >> 64);
+    value_type p00 = value_type(a0) * b0;
+    value_type p01 = value_type(a0) * b1;
+    value_type p10 = value_type(a1) * b0;
+    value_type middle = (p00 >> 64) + static_cast<uint64_t>(p01) +
+                        static_cast<uint64_t>(p10);
+    low = (middle << 64) | static_cast<uint64_t>(p00);
+    high = value_type(a1) * b1 + (p01 >> 64) + (p10 >> 64) + (middle >> 64);
+  }
+
+  // (high R + low) / R mod n for high lower than n
+  value_type reduce(value_type high, value_type low) const {
+    value_type m = low * n_inv_;
+    value_type mn_high, mn_low;
+    multiply(m, n_, mn_high, mn_low);
+    value_type result = high - mn_high;
+    return high < mn_high ? result + n_ : result;
+  }
+
+  value_type n_;
+  value_type n_inv_; // n^{-1} mod R
+  value_type one_;   // R mod n
+  value_type r2_;    // R^2 mod n
+};
+
+// Miller-Rabin test of odd n greater than 3 with accuracy 25, built-in
+// Utils::strong_probable_prime can't hold 256b products
+inline bool factor_is_prime(const unsigned __int128& n) {
+  typedef unsigned __int128 value_type;
+  if ((n >> 64) == 0) {
+    return Tests::miller_rabin_deterministic_64(static_cast<uint64_t>(n));
+  }
+  factor_modulus<value_type> modulus(n);
+  value_type odd = n - 1;
+  size_t powers = 0;
+  for (; (odd & 1) == 0; odd = odd >> 1) {
+    ++powers;
+  }
+  value_type minus_one = modulus.sub(0, modulus.one());
+  std::mt19937& engine = witness_engine();
+  for (size_t i = 0; i < 25; ++i) {
+    // first 13 primes are enough for n lower than 3.3 * 10^24, then random
+    // witnesses in [2, n - 2]
+    value_type witness = KnownPrimes::first_100_primes[i];
+    if (i >= 13) {
+      witness = 0;
+      for (int j = 0; j < 4; ++j) {
+        witness = (witness << 32) | engine();
+      }
+      witness = witness % (n - 3) + 2;
+    }
+    value_type x = modulus.pow(modulus.to_form(witness), odd);
+    if (x == modulus.one() || x == minus_one) {
+      continue;
+    }
+    for (size_t j = 1; j < powers && x != minus_one; ++j) {
+      x = modulus.mul(x, x);
+    }
+    if (x != minus_one) {
+      return false;
+    }
+  }
+  return true;
+}
+#endif
+
+// primality test for numbers without factors up to 7919
+template <typename UIntType> bool factor_is_prime(const UIntType& n) {
+  typedef Utils::number_traits<UIntType> traits;
+  if (traits::bit_length(n) <= 64) {
+    return Tests::miller_rabin_deterministic_64(
+        static_cast<uint64_t>(traits::low_64(n)));
+  }
+  return Tests::miller_rabin<UIntType, 25>(n);
+}
+
+// one run of Brent's variant of Pollard's rho for odd n, returns n when the
+// run fails
+template <typename UIntType>
+UIntType pollard_rho_brent(const factor_modulus<UIntType>& modulus,
+                           const UIntType& n, const UIntType& c) {
+  typedef typename factor_modulus<UIntType>::value_type value_type;
+  constexpr uint_fast64_t batch = 128;
+  const value_type addend = modulus.to_form(c);
+  auto next = [&](const value_type& x) {
+    return value_type(modulus.add(modulus.mul(x, x), addend));
+  };
+  value_type x = modulus.to_form(2);
+  value_type y = x;
+  value_type saved = x; // y before last batch
+  value_type product = modulus.one();
+  UIntType divisor = 1;
+  for (uint_fast64_t length = 1; divisor == 1; length *= 2) {
+    x = y;
+    for (uint_fast64_t i = 0; i < length; ++i) {
+      y = next(y);
+    }
+    for (uint_fast64_t k = 0; k < length && divisor == 1; k += batch) {
+      saved = y;
+      for (uint_fast64_t i = 0; i < std::min(batch, length - k); ++i) {
+        y = next(y);
+        product = modulus.mul(product, modulus.sub(x, y));
+      }
+      divisor = Details::gcd<UIntType>(modulus.from_form(product), n);
+    }
+  }
+  if (divisor == n) {
+    // product became multiple of n, steps of last batch are repeated one by
+    // one
+    do {
+      saved = next(saved);
+      divisor =
+          Details::gcd<UIntType>(modulus.from_form(modulus.sub(x, saved)), n);
+    } while (divisor == 1);
+  }
+  return divisor;
+}
+
+// appends prime factors of n without factors up to 7919
+template <typename UIntType>
+void factorize_cofactor(const UIntType& n, std::vector<UIntType>& factors) {
+  if (factor_is_prime(n)) {
+    factors.push_back(n);
+    return;
+  }
+  UIntType divisor = 1;
+  if (Utils::number_traits<UIntType>::bit_length(n) > 64) {
+    divisor = Factor::pollard_p_minus_1(n);
+  }
+  if (divisor == 1 || divisor == n) {
+    divisor = Factor::pollard_rho(n);
+  }
+  factorize_cofactor(divisor, factors);
+  factorize_cofactor(UIntType(n / divisor), factors);
+}
+}
+
+namespace Factor {
+template <typename UIntType> std::vector<UIntType> factorize(UIntType n) {
+  std::vector<UIntType> factors;
+  for (uint_fast32_t p : KnownPrimes::first_1000_primes) {
+    if (n / p < p) {
+      // n is 1 or prime
+      if (n != 1) {
+        factors.push_back(n);
+      }
+      return factors;
+    }
+    while (n % p == 0) {
+      factors.push_back(UIntType(p));
+      n /= p;
+    }
+  }
+  size_t small_factors = factors.size();
+  Details::factorize_cofactor(n, factors);
+  std::sort(factors.begin() + small_factors, factors.end());
+  return factors;
+}
+
+template <typename UIntType> UIntType pollard_rho(const UIntType& n) {
+  if ((n & 1) == 0) {
+    return 2;
+  }
+  Details::factor_modulus<UIntType> modulus(n);
+  for (UIntType c = 1;; ++c) {
+    UIntType divisor = Details::pollard_rho_brent(modulus, n, c);
+    if (divisor != n) {
+      return divisor;
+    }
+  }
+}
+
+template <typename UIntType>
+UIntType pollard_p_minus_1(const UIntType& n, uint_fast32_t bound) {
+  Details::factor_modulus<UIntType> modulus(n);
+  auto a = modulus.to_form(2);
+  Generators::primes_in_range(2, uint_fast64_t(bound) + 1,
+                              [&](uint_fast64_t p) {
+                                // highest power of p up to bound
+                                uint_fast64_t power = p;
+                                while (power <= bound / p) {
+                                  power *= p;
+                                }
+                                a = modulus.pow(a, UIntType(power));
+                              });
+  return Details::gcd<UIntType>(
+      modulus.from_form(modulus.sub(a, modulus.one())), n);
+}
 }
 }
 
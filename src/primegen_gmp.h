@@ -0,0 +1,109 @@
+#ifndef PRIMEGEN_GMP_H_
+#define PRIMEGEN_GMP_H_
+
+#include "primegen.h"
+#include <gmpxx.h>
+
+/**
+* @file
+* @brief PrimeGen specializations for GNU MP Bignum Library's \c mpz_class
+*
+* @details Generic implementation uses only \c mpz_class operators, so every
+* modular multiplication builds expression temporaries and exponentiation is
+* done by plain multiplication and division. This header specializes hot paths
+* for \c mpz_class to use GMP's own kernels: \c mpz_powm for exponentiation,
+* \c mpz_mul and \c mpz_tdiv_r in reused buffers for squaring, \c mpz_scan1 for
+* Utils::fac_2_powers and \c mpz_sizeinbase for Utils::log (see
+* Utils::number_traits).
+*
+* Include this header instead of primegen.h in every translation unit using
+* PrimeGen with \c mpz_class, specializations must be visible before the first
+* use of the library with \c mpz_class.
+*/
+
+namespace PrimeGen {
+namespace Utils {
+/// @cond
+template <> struct number_traits<mpz_class> {
+  static size_t bit_length(const mpz_class& n) {
+    // mpz_sizeinbase returns 1 for 0
+    return sgn(n) == 0 ? 0 : mpz_sizeinbase(n.get_mpz_t(), 2);
+  }
+
+  static size_t trailing_zeros(const mpz_class& n) {
+    return mpz_scan1(n.get_mpz_t(), 0);
+  }
+
+  static uint_fast64_t low_64(const mpz_class& n) {
+    uint_fast64_t low = 0;
+    for (int i = 0; i * GMP_NUMB_BITS < 64; ++i) {
+      low |= static_cast<uint_fast64_t>(mpz_getlimbn(n.get_mpz_t(), i))
+             << (i * GMP_NUMB_BITS);
+    }
+    return low;
+  }
+
+  static uint_fast64_t high_64(const mpz_class& n) {
+    size_t bits = bit_length(n);
+    if (bits <= 64) {
+      return low_64(n);
+    }
+    mpz_class high;
+    mpz_tdiv_q_2exp(high.get_mpz_t(), n.get_mpz_t(), bits - 64);
+    return low_64(high);
+  }
+
+  static mpz_class mul_mod(const mpz_class& a, const mpz_class& b,
+                           const mpz_class& mod) {
+    mpz_class result;
+    mpz_mul(result.get_mpz_t(), a.get_mpz_t(), b.get_mpz_t());
+    mpz_tdiv_r(result.get_mpz_t(), result.get_mpz_t(), mod.get_mpz_t());
+    return result;
+  }
+
+  static mpz_class pow_mod(mpz_class base, const mpz_class& exp,
+                           const mpz_class& mod) {
+    mpz_powm(base.get_mpz_t(), base.get_mpz_t(), exp.get_mpz_t(),
+             mod.get_mpz_t());
+    return base;
+  }
+};
+
+template <> class strong_probable_prime<mpz_class, false> {
+public:
+  explicit strong_probable_prime(const mpz_class& n)
+      : n_(n), n_minus_1_(n - 1) {
+    powers_ = mpz_scan1(n_minus_1_.get_mpz_t(), 0);
+    mpz_tdiv_q_2exp(odd_.get_mpz_t(), n_minus_1_.get_mpz_t(), powers_);
+  }
+
+  bool operator()(const mpz_class& witness) const {
+    // both buffers are reused by all squarings
+    mpz_class x;
+    mpz_class square;
+    mpz_powm(x.get_mpz_t(), witness.get_mpz_t(), odd_.get_mpz_t(),
+             n_.get_mpz_t());
+    if (mpz_cmp_ui(x.get_mpz_t(), 1) == 0 || x == n_minus_1_) {
+      return true;
+    }
+    for (mp_bitcnt_t j = 1; j < powers_; ++j) {
+      mpz_mul(square.get_mpz_t(), x.get_mpz_t(), x.get_mpz_t());
+      mpz_tdiv_r(x.get_mpz_t(), square.get_mpz_t(), n_.get_mpz_t());
+      if (mpz_cmp_ui(x.get_mpz_t(), 1) == 0 || x == n_minus_1_) {
+        break;
+      }
+    }
+    return x == n_minus_1_;
+  }
+
+private:
+  mpz_class n_;
+  mpz_class n_minus_1_;
+  mpz_class odd_;       // n - 1 = 2^powers_ * odd_
+  mp_bitcnt_t powers_;
+};
+/// @endcond
+}
+}
+
+#endif // PRIMEGEN_GMP_H_
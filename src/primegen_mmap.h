@@ -0,0 +1,272 @@
+#ifndef PRIMEGEN_MMAP_H_
+#define PRIMEGEN_MMAP_H_
+
+#include "primegen.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+* @file
+* @brief Persistent prime bitmap stored in file and mapped to memory
+*
+* @details File holds 16 bytes header (magic \c PGWHEEL1 and limit as 64b
+* little-endian number) followed by mod 30 wheel bitmap of numbers in [0,
+* limit): byte \c k represents numbers \f$ 30k + r \f$ for \f$ r \f$ in 1, 7,
+* 11, 13, 17, 19, 23, 29 (bit \c i for i-th residue), which is the same layout
+* Generators::primes_in_range sieves in. Bitmap of all 32b numbers takes 143
+* MB. Reader maps the file read-only and shared, so all processes using the
+* same file share one copy in page cache and startup costs nothing.
+*
+* This header requires POSIX (\c mmap), unlike the rest of library.
+*/
+
+namespace PrimeGen {
+/**
+* @brief Prime tables stored in files
+*/
+namespace Storage {
+/**
+* @brief Sieves primes in [0, limit) and writes them as bitmap file
+*
+* @details Segments of the sieve are written directly to the mapped output
+* file by multiple threads (see Generators::count_primes_in_range). Requires
+* linking with thread library (\c -pthread).
+*
+* @param path path of file, existing file is replaced
+* @param limit upper bound (exclusive) of stored numbers, must be lower than
+* \f$ 2^{63} \f$
+* @param threads number of threads, 0 means \c
+* std::thread::hardware_concurrency()
+*
+* @return \c false if the file could not be written
+*/
+inline bool write_prime_bitmap(const char* path, uint_fast64_t limit,
+                               unsigned threads = 0);
+
+/**
+* @brief Read-only prime bitmap mapped from file
+*
+* @details All queries are answered from mapped memory without any sieving or
+* primality testing, is_prime is one memory access. Object is not copyable,
+* file stays mapped until destruction.
+*
+* @see write_prime_bitmap
+*/
+class prime_bitmap {
+public:
+  /**
+  * @brief Maps bitmap file to memory
+  *
+  * @param path path of file written by write_prime_bitmap
+  */
+  explicit prime_bitmap(const char* path);
+  ~prime_bitmap();
+  prime_bitmap(const prime_bitmap&) = delete;
+  prime_bitmap& operator=(const prime_bitmap&) = delete;
+
+  /// @return \c false if the file could not be mapped or it's not valid
+  bool is_open() const { return data_ != nullptr; }
+  /// @return upper bound (exclusive) of stored numbers
+  uint_fast64_t limit() const { return limit_; }
+
+  /**
+  * @param n number lower than limit()
+  *
+  * @return \c true if \c n is prime
+  */
+  bool is_prime(uint_fast64_t n) const;
+
+  /**
+  * @param n any number
+  *
+  * @return smallest prime greater than \c n, 0 if there is no such prime
+  * lower than limit()
+  */
+  uint_fast64_t next_prime(uint_fast64_t n) const;
+
+  /**
+  * @param n any number
+  *
+  * @return greatest prime lower than \c n (and limit()), 0 if there is no
+  * such prime
+  */
+  uint_fast64_t prev_prime(uint_fast64_t n) const;
+
+private:
+  void* map_;
+  size_t map_size_;
+  const uint8_t* data_; // bitmap after header
+  uint_fast64_t limit_;
+};
+}
+}
+
+/* IMPLEMENTATION */
+
+namespace PrimeGen {
+namespace Details {
+constexpr char bitmap_magic[8] = { 'P', 'G', 'W', 'H', 'E', 'E', 'L', '1' };
+constexpr size_t bitmap_header_size = 16;
+
+// bits of wheel30 residues not lower than r
+inline uint_fast8_t wheel30_mask_from(uint_fast64_t r) {
+  return static_cast<uint_fast8_t>(0xff << wheel30_next[r]);
+}
+
+// bits of wheel30 residues not greater than r
+inline uint_fast8_t wheel30_mask_to(uint_fast64_t r) {
+  uint_fast8_t index = wheel30_next[r];
+  return static_cast<uint_fast8_t>((1 << (index + (wheel30[index] == r))) -
+                                   1);
+}
+}
+
+namespace Storage {
+inline bool write_prime_bitmap(const char* path, uint_fast64_t limit,
+                               unsigned threads) {
+  uint_fast64_t bytes = (limit + 29) / 30;
+  size_t size = Details::bitmap_header_size + bytes;
+  int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    ::close(fd);
+    return false;
+  }
+  void* map =
+      ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  uint8_t* header = static_cast<uint8_t*>(map);
+  std::memcpy(header, Details::bitmap_magic, sizeof(Details::bitmap_magic));
+  for (int i = 0; i < 8; ++i) {
+    header[8 + i] = static_cast<uint8_t>(limit >> (8 * i));
+  }
+  uint8_t* data = header + Details::bitmap_header_size;
+
+  uint_fast64_t hi = std::max<uint_fast64_t>(30 * bytes, 2);
+  const std::vector<uint_fast32_t> sieving_primes = Details::sieving_primes(hi);
+  constexpr uint_fast64_t block = Details::wheel_sieve::parallel_block;
+  uint_fast64_t blocks = (hi + block - 1) / block;
+  std::atomic<uint_fast64_t> next_block(0);
+  Details::run_parallel(Details::thread_count(threads), [&](unsigned) {
+    for (uint_fast64_t b = next_block++; b < blocks; b = next_block++) {
+      uint_fast64_t block_lo = b * block;
+      uint_fast64_t block_hi = std::min(block_lo + block, hi);
+      Details::wheel_sieve sieve(block_lo, block_hi, sieving_primes);
+      while (sieve.next_segment()) {
+        const std::vector<uint_fast8_t>& segment = sieve.segment();
+        uint_fast64_t byte = sieve.segment_low() / 30;
+        uint_fast64_t length =
+            std::min<uint_fast64_t>(segment.size(), bytes - byte);
+        std::copy(segment.begin(), segment.begin() + length, data + byte);
+      }
+    }
+  });
+  if (bytes > 0) {
+    // numbers from limit to the end of last byte are not stored
+    uint_fast64_t r = limit - 30 * (bytes - 1);
+    data[bytes - 1] &= r == 30 ? 0xff : ~Details::wheel30_mask_from(r);
+  }
+  bool synced = ::msync(map, size, MS_SYNC) == 0;
+  return ::munmap(map, size) == 0 && synced;
+}
+
+inline prime_bitmap::prime_bitmap(const char* path)
+    : map_(MAP_FAILED), map_size_(0), data_(nullptr), limit_(0) {
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat status;
+  if (::fstat(fd, &status) == 0 &&
+      size_t(status.st_size) >= Details::bitmap_header_size) {
+    map_size_ = size_t(status.st_size);
+    map_ = ::mmap(nullptr, map_size_, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  ::close(fd);
+  if (map_ == MAP_FAILED) {
+    return;
+  }
+  const uint8_t* header = static_cast<const uint8_t*>(map_);
+  uint_fast64_t limit = 0;
+  for (int i = 0; i < 8; ++i) {
+    limit |= uint_fast64_t(header[8 + i]) << (8 * i);
+  }
+  if (std::memcmp(header, Details::bitmap_magic,
+                  sizeof(Details::bitmap_magic)) == 0 &&
+      (map_size_ - Details::bitmap_header_size) == (limit + 29) / 30) {
+    data_ = header + Details::bitmap_header_size;
+    limit_ = limit;
+  }
+}
+
+inline prime_bitmap::~prime_bitmap() {
+  if (map_ != MAP_FAILED) {
+    ::munmap(map_, map_size_);
+  }
+}
+
+inline bool prime_bitmap::is_prime(uint_fast64_t n) const {
+  if (n < 7) {
+    return n == 2 || n == 3 || n == 5;
+  }
+  uint_fast8_t index = Details::wheel30_next[n % 30];
+  return Details::wheel30[index] == n % 30 &&
+         ((data_[n / 30] >> index) & 1) != 0;
+}
+
+inline uint_fast64_t prime_bitmap::next_prime(uint_fast64_t n) const {
+  for (uint_fast64_t p : { 2, 3, 5 }) {
+    if (n < p) {
+      return p < limit_ ? p : 0;
+    }
+  }
+  if (n >= limit_) {
+    return 0; // also keeps n + 1 from overflowing
+  }
+  uint_fast64_t bytes = (limit_ + 29) / 30;
+  uint_fast64_t byte = (n + 1) / 30;
+  if (byte >= bytes) {
+    return 0;
+  }
+  uint_fast8_t bits = data_[byte] & Details::wheel30_mask_from((n + 1) % 30);
+  while (bits == 0) {
+    if (++byte == bytes) {
+      return 0;
+    }
+    bits = data_[byte];
+  }
+  return 30 * byte + Details::wheel30[Details::count_trailing_zeros(bits)];
+}
+
+inline uint_fast64_t prime_bitmap::prev_prime(uint_fast64_t n) const {
+  n = std::min(n, limit_);
+  if (n <= 7) {
+    return n > 5 ? 5 : n > 3 ? 3 : n > 2 ? 2 : 0;
+  }
+  uint_fast64_t byte = (n - 1) / 30;
+  uint_fast8_t bits = data_[byte] & Details::wheel30_mask_to((n - 1) % 30);
+  while (bits == 0) {
+    if (byte == 0) {
+      return 5;
+    }
+    bits = data_[--byte];
+  }
+  // highest set bit
+  uint_fast8_t index = 7;
+  while ((bits >> index) == 0) {
+    --index;
+  }
+  return 30 * byte + Details::wheel30[index];
+}
+}
+}
+
+#endif // PRIMEGEN_MMAP_H_
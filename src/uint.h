@@ -0,0 +1,552 @@
+#ifndef PRIMEGEN_UINT_H_
+#define PRIMEGEN_UINT_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <type_traits>
+
+namespace PrimeGen {
+namespace Details {
+// limbs of UInt and double-width type for products of limbs
+#ifdef __SIZEOF_INT128__
+typedef uint64_t limb_type;
+typedef unsigned __int128 double_limb_type;
+#else
+typedef uint32_t limb_type;
+typedef uint64_t double_limb_type;
+#endif
+constexpr int limb_digits = std::numeric_limits<limb_type>::digits;
+
+// number of limbs without leading zero limbs
+inline size_t used_limbs(const limb_type* a, size_t size) {
+  while (size > 0 && a[size - 1] == 0) {
+    --size;
+  }
+  return size;
+}
+
+// result = a * b mod 2^(limb_digits * size), result must not overlap a or b
+inline void mul_limbs(const limb_type* a, size_t a_size, const limb_type* b,
+                      size_t b_size, limb_type* result, size_t size) {
+  std::fill(result, result + size, 0);
+  for (size_t i = 0; i < a_size && i < size; ++i) {
+    limb_type carry = 0;
+    size_t j = 0;
+    for (; j < b_size && i + j < size; ++j) {
+      double_limb_type t =
+          double_limb_type(a[i]) * b[j] + result[i + j] + carry;
+      result[i + j] = static_cast<limb_type>(t);
+      carry = static_cast<limb_type>(t >> limb_digits);
+    }
+    if (i + j < size) {
+      result[i + j] = carry;
+    }
+  }
+}
+
+// a = a / divisor, returns remainder
+inline limb_type divide_limbs_short(limb_type* a, size_t size,
+                                    limb_type divisor) {
+  limb_type remainder = 0;
+  for (size_t i = size; i-- > 0;) {
+    double_limb_type t = (double_limb_type(remainder) << limb_digits) | a[i];
+    a[i] = static_cast<limb_type>(t / divisor);
+    remainder = static_cast<limb_type>(t % divisor);
+  }
+  return remainder;
+}
+
+// Knuth's algorithm D, quotient has u_size - v_size + 1 limbs, remainder has
+// v_size limbs, v[v_size - 1] must not be 0 and v_size must be at least 2,
+// u_work and v_work are scratch of u_size + 1 and v_size limbs
+inline void divide_limbs(const limb_type* u, size_t u_size, const limb_type* v,
+                         size_t v_size, limb_type* quotient,
+                         limb_type* remainder, limb_type* u_work,
+                         limb_type* v_work) {
+  // normalize, so highest bit of divisor is set
+  int shift = 0;
+  for (limb_type top = v[v_size - 1]; (top >> (limb_digits - 1)) == 0;
+       top <<= 1) {
+    ++shift;
+  }
+  // shifting in two steps is defined even for shift == 0
+  const int back_shift = limb_digits - 1 - shift;
+  for (size_t i = v_size - 1; i > 0; --i) {
+    v_work[i] = (v[i] << shift) | ((v[i - 1] >> 1) >> back_shift);
+  }
+  v_work[0] = v[0] << shift;
+  u_work[u_size] = (u[u_size - 1] >> 1) >> back_shift;
+  for (size_t i = u_size - 1; i > 0; --i) {
+    u_work[i] = (u[i] << shift) | ((u[i - 1] >> 1) >> back_shift);
+  }
+  u_work[0] = u[0] << shift;
+
+  const double_limb_type base = double_limb_type(1) << limb_digits;
+  const limb_type v_top = v_work[v_size - 1];
+  const limb_type v_next = v_work[v_size - 2];
+  for (size_t j = u_size - v_size + 1; j-- > 0;) {
+    // estimate quotient digit from top two limbs, it's at most 2 too big
+    double_limb_type top =
+        (double_limb_type(u_work[j + v_size]) << limb_digits) |
+        u_work[j + v_size - 1];
+    double_limb_type q_hat = top / v_top;
+    double_limb_type r_hat = top % v_top;
+    while (q_hat >= base ||
+           q_hat * v_next >
+               ((r_hat << limb_digits) | u_work[j + v_size - 2])) {
+      --q_hat;
+      r_hat += v_top;
+      if (r_hat >= base) {
+        break;
+      }
+    }
+    // multiply and subtract
+    limb_type borrow = 0;
+    limb_type carry = 0;
+    for (size_t i = 0; i < v_size; ++i) {
+      double_limb_type product = q_hat * v_work[i] + carry;
+      carry = static_cast<limb_type>(product >> limb_digits);
+      limb_type low = static_cast<limb_type>(product);
+      limb_type digit = u_work[i + j];
+      u_work[i + j] = digit - low - borrow;
+      borrow = (digit < low || (digit == low && borrow)) ? 1 : 0;
+    }
+    limb_type digit = u_work[j + v_size];
+    u_work[j + v_size] = digit - carry - borrow;
+    bool negative = digit < carry || (digit == carry && borrow);
+    // estimate was 1 too big, add back
+    if (negative) {
+      --q_hat;
+      limb_type add_carry = 0;
+      for (size_t i = 0; i < v_size; ++i) {
+        double_limb_type sum =
+            double_limb_type(u_work[i + j]) + v_work[i] + add_carry;
+        u_work[i + j] = static_cast<limb_type>(sum);
+        add_carry = static_cast<limb_type>(sum >> limb_digits);
+      }
+      u_work[j + v_size] += add_carry;
+    }
+    quotient[j] = static_cast<limb_type>(q_hat);
+  }
+  // denormalize remainder
+  for (size_t i = 0; i < v_size; ++i) {
+    remainder[i] = (u_work[i] >> shift) | ((u_work[i + 1] << 1) << back_shift);
+  }
+}
+}
+
+/**
+* @brief Fixed-width unsigned integer
+*
+* @details Number is stored in array of limbs on stack, so no operation
+* allocates memory. Arithmetic is done modulo \f$ 2^{Bits} \f$, the same way
+* as for built-in unsigned types, and the class satisfies requirements on \c
+* UIntType (see @ref bignums), so it can be used in place of \c mpz_class
+* without GMP. As for other big numbers, \c Bits must be at least 2 times size
+* of tested numbers (e.g. \c UInt<2048> for 1024b primes). Multiplication is
+* schoolbook with only limbs below \c Bits computed, division is Knuth's
+* algorithm D (with fast path for one-limb divisors).
+*
+* @tparam Bits width of the number in bits, must be multiple of 64
+*/
+template <size_t Bits> class UInt {
+  static_assert(Bits > 0 && Bits % 64 == 0, "Bits must be multiple of 64");
+
+public:
+  /// Type of single limb
+  typedef Details::limb_type limb_type;
+  /// Number of limbs
+  static constexpr size_t limbs = Bits / Details::limb_digits;
+
+  /// Constructs 0
+  constexpr UInt() : limbs_() {}
+
+  /**
+  * @brief Conversion from built-in integer type
+  *
+  * @details As for built-in types, negative values are taken modulo \f$
+  * 2^{Bits} \f$.
+  */
+  template <typename T, typename = typename std::enable_if<
+                            std::is_integral<T>::value &&
+                            !std::is_same<T, bool>::value>::type>
+  constexpr UInt(T value)
+      : limbs_() {
+    typedef typename std::common_type<typename std::make_unsigned<T>::type,
+                                      limb_type>::type wide_type;
+    wide_type rest = static_cast<wide_type>(value);
+    limb_type fill = value < T(0) ? ~limb_type(0) : 0;
+    for (size_t i = 0; i < limbs; ++i) {
+      limbs_[i] = rest == 0 ? fill : static_cast<limb_type>(rest);
+      // shifting in two steps is defined even if wide_type is limb_type
+      rest = (rest >> (Details::limb_digits / 2)) >>
+             (Details::limb_digits / 2);
+    }
+  }
+
+  /// Conversion from other width, number is truncated or zero-extended
+  template <size_t OtherBits>
+  explicit UInt(const UInt<OtherBits>& other)
+      : limbs_() {
+    for (size_t i = 0; i < limbs && i < UInt<OtherBits>::limbs; ++i) {
+      limbs_[i] = other.limb(i);
+    }
+  }
+
+  /// Conversion to built-in integer type, higher bits are truncated
+  template <typename T, typename = typename std::enable_if<
+                            std::is_integral<T>::value>::type>
+  explicit operator T() const {
+    typedef typename std::common_type<typename std::make_unsigned<T>::type,
+                                      limb_type>::type wide_type;
+    wide_type result = 0;
+    for (size_t i = std::min(limbs, sizeof(T) * 8 / Details::limb_digits + 1);
+         i-- > 0;) {
+      result = (result << (Details::limb_digits / 2)) <<
+               (Details::limb_digits / 2);
+      result |= limbs_[i];
+    }
+    return static_cast<T>(result);
+  }
+
+  /// @return i-th limb, limb 0 is the lowest one
+  constexpr limb_type limb(size_t i) const { return limbs_[i]; }
+  /// @return reference to i-th limb, limb 0 is the lowest one
+  constexpr limb_type& limb(size_t i) { return limbs_[i]; }
+
+  /// @return number of significant bits, 0 for 0
+  size_t bit_length() const {
+    size_t size = Details::used_limbs(limbs_, limbs);
+    if (size == 0) {
+      return 0;
+    }
+    size_t bits = (size - 1) * Details::limb_digits;
+    for (limb_type top = limbs_[size - 1]; top != 0; top >>= 1) {
+      ++bits;
+    }
+    return bits;
+  }
+
+  UInt& operator+=(const UInt& b) {
+    limb_type carry = 0;
+    for (size_t i = 0; i < limbs; ++i) {
+      limb_type sum = limbs_[i] + carry;
+      carry = sum < carry ? 1 : 0;
+      limbs_[i] = sum + b.limbs_[i];
+      carry += limbs_[i] < sum ? 1 : 0;
+    }
+    return *this;
+  }
+
+  UInt& operator-=(const UInt& b) {
+    limb_type borrow = 0;
+    for (size_t i = 0; i < limbs; ++i) {
+      limb_type a = limbs_[i];
+      limbs_[i] = a - b.limbs_[i] - borrow;
+      borrow = (a < b.limbs_[i] || (a == b.limbs_[i] && borrow)) ? 1 : 0;
+    }
+    return *this;
+  }
+
+  UInt& operator*=(const UInt& b) {
+    UInt product;
+    Details::mul_limbs(limbs_, Details::used_limbs(limbs_, limbs), b.limbs_,
+                       Details::used_limbs(b.limbs_, limbs), product.limbs_,
+                       limbs);
+    return *this = product;
+  }
+
+  UInt& operator/=(const UInt& b) {
+    UInt remainder;
+    divide(*this, b, *this, remainder);
+    return *this;
+  }
+
+  UInt& operator%=(const UInt& b) {
+    UInt quotient;
+    divide(*this, b, quotient, *this);
+    return *this;
+  }
+
+  UInt& operator&=(const UInt& b) {
+    for (size_t i = 0; i < limbs; ++i) {
+      limbs_[i] &= b.limbs_[i];
+    }
+    return *this;
+  }
+
+  UInt& operator|=(const UInt& b) {
+    for (size_t i = 0; i < limbs; ++i) {
+      limbs_[i] |= b.limbs_[i];
+    }
+    return *this;
+  }
+
+  UInt& operator^=(const UInt& b) {
+    for (size_t i = 0; i < limbs; ++i) {
+      limbs_[i] ^= b.limbs_[i];
+    }
+    return *this;
+  }
+
+  UInt& operator<<=(size_t shift) {
+    size_t limb_shift = shift / Details::limb_digits;
+    int bit_shift = shift % Details::limb_digits;
+    for (size_t i = limbs; i-- > 0;) {
+      limb_type value = 0;
+      if (i >= limb_shift) {
+        value = limbs_[i - limb_shift] << bit_shift;
+        if (bit_shift != 0 && i > limb_shift) {
+          value |= limbs_[i - limb_shift - 1] >>
+                   (Details::limb_digits - bit_shift);
+        }
+      }
+      limbs_[i] = value;
+    }
+    return *this;
+  }
+
+  UInt& operator>>=(size_t shift) {
+    size_t limb_shift = shift / Details::limb_digits;
+    int bit_shift = shift % Details::limb_digits;
+    for (size_t i = 0; i < limbs; ++i) {
+      limb_type value = 0;
+      if (i + limb_shift < limbs) {
+        value = limbs_[i + limb_shift] >> bit_shift;
+        if (bit_shift != 0 && i + limb_shift + 1 < limbs) {
+          value |= limbs_[i + limb_shift + 1]
+                   << (Details::limb_digits - bit_shift);
+        }
+      }
+      limbs_[i] = value;
+    }
+    return *this;
+  }
+
+  UInt& operator++() {
+    for (size_t i = 0; i < limbs && ++limbs_[i] == 0; ++i) {
+    }
+    return *this;
+  }
+
+  UInt& operator--() {
+    for (size_t i = 0; i < limbs && limbs_[i]-- == 0; ++i) {
+    }
+    return *this;
+  }
+
+  UInt operator++(int) {
+    UInt old = *this;
+    ++*this;
+    return old;
+  }
+
+  UInt operator--(int) {
+    UInt old = *this;
+    --*this;
+    return old;
+  }
+
+  explicit operator bool() const {
+    return Details::used_limbs(limbs_, limbs) != 0;
+  }
+
+  friend UInt operator+(UInt a, const UInt& b) { return a += b; }
+  friend UInt operator-(UInt a, const UInt& b) { return a -= b; }
+  friend UInt operator*(UInt a, const UInt& b) { return a *= b; }
+  friend UInt operator/(UInt a, const UInt& b) { return a /= b; }
+  friend UInt operator%(UInt a, const UInt& b) { return a %= b; }
+  friend UInt operator&(UInt a, const UInt& b) { return a &= b; }
+  friend UInt operator|(UInt a, const UInt& b) { return a |= b; }
+  friend UInt operator^(UInt a, const UInt& b) { return a ^= b; }
+  friend UInt operator<<(UInt a, size_t shift) { return a <<= shift; }
+  friend UInt operator>>(UInt a, size_t shift) { return a >>= shift; }
+  friend UInt operator-(const UInt& a) { return UInt() - a; }
+  friend constexpr UInt operator~(UInt a) {
+    for (size_t i = 0; i < limbs; ++i) {
+      a.limbs_[i] = ~a.limbs_[i];
+    }
+    return a;
+  }
+
+  friend bool operator==(const UInt& a, const UInt& b) {
+    return std::equal(a.limbs_, a.limbs_ + limbs, b.limbs_);
+  }
+  friend bool operator!=(const UInt& a, const UInt& b) { return !(a == b); }
+  friend bool operator<(const UInt& a, const UInt& b) {
+    for (size_t i = limbs; i-- > 0;) {
+      if (a.limbs_[i] != b.limbs_[i]) {
+        return a.limbs_[i] < b.limbs_[i];
+      }
+    }
+    return false;
+  }
+  friend bool operator>(const UInt& a, const UInt& b) { return b < a; }
+  friend bool operator<=(const UInt& a, const UInt& b) { return !(b < a); }
+  friend bool operator>=(const UInt& a, const UInt& b) { return !(a < b); }
+
+  /**
+  * @brief Division with remainder
+  *
+  * @details Division by 0 is undefined as for built-in types. Results may
+  * alias arguments.
+  */
+  static void divide(const UInt& dividend, const UInt& divisor,
+                     UInt& quotient, UInt& remainder) {
+    size_t u_size = Details::used_limbs(dividend.limbs_, limbs);
+    size_t v_size = Details::used_limbs(divisor.limbs_, limbs);
+    if (u_size < v_size || v_size == 0) {
+      remainder = dividend;
+      quotient = UInt();
+      return;
+    }
+    // one-limb numbers never need long division, constant condition removes
+    // it from their instantiation
+    if (limbs == 1 || v_size == 1) {
+      limb_type divisor_limb = divisor.limbs_[0];
+      quotient = dividend;
+      remainder = UInt(Details::divide_limbs_short(quotient.limbs_, u_size,
+                                                   divisor_limb));
+      return;
+    }
+    UInt q;
+    UInt r;
+    limb_type u_work[limbs + 1];
+    limb_type v_work[limbs];
+    Details::divide_limbs(dividend.limbs_, u_size, divisor.limbs_, v_size,
+                          q.limbs_, r.limbs_, u_work, v_work);
+    quotient = q;
+    remainder = r;
+  }
+
+private:
+  limb_type limbs_[limbs];
+};
+
+/**
+* @brief Double-width product of fixed-width integers
+*
+* @return \f$ a b \f$ without any truncation
+*/
+template <size_t Bits>
+UInt<2 * Bits> wide_mul(const UInt<Bits>& a, const UInt<Bits>& b) {
+  typedef typename UInt<Bits>::limb_type limb_type;
+  limb_type a_limbs[UInt<Bits>::limbs];
+  limb_type b_limbs[UInt<Bits>::limbs];
+  limb_type result[UInt<2 * Bits>::limbs];
+  for (size_t i = 0; i < UInt<Bits>::limbs; ++i) {
+    a_limbs[i] = a.limb(i);
+    b_limbs[i] = b.limb(i);
+  }
+  Details::mul_limbs(a_limbs, Details::used_limbs(a_limbs, UInt<Bits>::limbs),
+                     b_limbs, Details::used_limbs(b_limbs, UInt<Bits>::limbs),
+                     result, UInt<2 * Bits>::limbs);
+  UInt<2 * Bits> product;
+  for (size_t i = 0; i < UInt<2 * Bits>::limbs; ++i) {
+    product.limb(i) = result[i];
+  }
+  return product;
+}
+
+/**
+* @brief Writes number in decimal (or hexadecimal if \c std::hex is set)
+*/
+template <size_t Bits>
+std::ostream& operator<<(std::ostream& os, const UInt<Bits>& n) {
+  typedef typename UInt<Bits>::limb_type limb_type;
+  limb_type limbs[UInt<Bits>::limbs];
+  for (size_t i = 0; i < UInt<Bits>::limbs; ++i) {
+    limbs[i] = n.limb(i);
+  }
+  size_t size = Details::used_limbs(limbs, UInt<Bits>::limbs);
+  const char* symbols = (os.flags() & std::ios_base::uppercase)
+                            ? "0123456789ABCDEF"
+                            : "0123456789abcdef";
+  // digits are produced from the lowest one, leading zeros are removed later
+  std::string digits;
+  if ((os.flags() & std::ios_base::basefield) == std::ios_base::hex) {
+    for (size_t i = 0; i < size; ++i) {
+      for (int shift = 0; shift < Details::limb_digits; shift += 4) {
+        digits.push_back(symbols[(limbs[i] >> shift) & 15]);
+      }
+    }
+  } else {
+    // chunks of decimal digits fitting to one limb
+    const int chunk_digits = std::numeric_limits<limb_type>::digits10;
+    limb_type chunk_base = 1;
+    for (int i = 0; i < chunk_digits; ++i) {
+      chunk_base *= 10;
+    }
+    while (size != 0) {
+      limb_type chunk = Details::divide_limbs_short(limbs, size, chunk_base);
+      size = Details::used_limbs(limbs, size);
+      for (int i = 0; i < chunk_digits; ++i) {
+        digits.push_back(symbols[chunk % 10]);
+        chunk /= 10;
+      }
+    }
+  }
+  while (digits.size() > 1 && digits.back() == '0') {
+    digits.pop_back();
+  }
+  if (digits.empty()) {
+    digits.push_back('0');
+  }
+  if ((os.flags() & std::ios_base::basefield) == std::ios_base::hex &&
+      (os.flags() & std::ios_base::showbase)) {
+    digits += (os.flags() & std::ios_base::uppercase) ? "X0" : "x0";
+  }
+  std::reverse(digits.begin(), digits.end());
+  return os << digits;
+}
+
+/**
+* @brief Reads number in decimal
+*/
+template <size_t Bits>
+std::istream& operator>>(std::istream& is, UInt<Bits>& n) {
+  std::istream::sentry sentry(is);
+  if (!sentry) {
+    return is;
+  }
+  UInt<Bits> result;
+  bool any_digit = false;
+  for (int c = is.peek(); c >= '0' && c <= '9'; c = is.peek()) {
+    result = result * 10 + (is.get() - '0');
+    any_digit = true;
+  }
+  if (any_digit) {
+    n = result;
+  } else {
+    is.setstate(std::ios_base::failbit);
+  }
+  return is;
+}
+}
+
+namespace std {
+template <size_t Bits> class numeric_limits<PrimeGen::UInt<Bits> > {
+public:
+  static constexpr bool is_specialized = true;
+  static constexpr bool is_signed = false;
+  static constexpr bool is_integer = true;
+  static constexpr bool is_exact = true;
+  static constexpr bool is_bounded = true;
+  static constexpr bool is_modulo = true;
+  static constexpr int radix = 2;
+  static constexpr int digits = Bits;
+  static constexpr int digits10 = Bits * 30103 / 100000; // log10(2)
+  static constexpr PrimeGen::UInt<Bits> min() { return {}; }
+  static constexpr PrimeGen::UInt<Bits> lowest() { return {}; }
+  static constexpr PrimeGen::UInt<Bits> max() {
+    return ~PrimeGen::UInt<Bits>();
+  }
+};
+}
+
+#endif // PRIMEGEN_UINT_H_